@@ -0,0 +1,33 @@
+#include <WiFiProvisioner.h>
+#include <WiFi.h>
+
+// Flash the same sketch on a batch of devices and power them up together.
+// Configure any one of them through its portal; once it has joined the
+// network it pushes the credentials to the others over ESP-NOW, so their
+// portals finish without anyone visiting them.
+
+static const char* FANOUT_KEY = "change-me-per-product";
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    WiFiProvisioner provisioner("My Device Setup");
+    provisioner.getConfig().FANOUT_KEY = FANOUT_KEY;
+    // ESP-NOW shares the radio's channel, so follow the strongest network
+    provisioner.getConfig().AP_CHANNEL_FROM_SCAN = true;
+
+    WiFiCredentials creds = provisioner.connectOrProvision();
+    if (!creds.success) {
+        Serial.printf("Provisioning failed: %s\n", creds.error.c_str());
+        return;
+    }
+    Serial.printf("Connected to %s\n", creds.ssid.c_str());
+
+    size_t served = provisioner.shareCredentials(creds, 60000);
+    Serial.printf("Shared credentials with %u devices\n", (unsigned)served);
+}
+
+void loop() {
+    delay(1000);
+}
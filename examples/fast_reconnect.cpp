@@ -0,0 +1,29 @@
+#include <WiFiProvisioner.h>
+#include <WiFi.h>
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    WiFiProvisioner provisioner("My Device Setup");
+
+    // Joins the network saved on a previous boot, and only opens the portal
+    // when there is none or it can't be reached
+    WiFiCredentials creds = provisioner.connectOrProvision();
+
+    if (creds.success) {
+        Serial.printf("Connected to %s, IP Address: %s\n",
+                      creds.ssid.c_str(), WiFi.localIP().toString().c_str());
+    } else {
+        Serial.printf("Provisioning failed: %s\n", creds.error.c_str());
+    }
+}
+
+void loop() {
+    // Hold the BOOT button on GPIO0 to forget the saved network
+    if (digitalRead(0) == LOW) {
+        WiFiProvisioner().forgetCredentials();
+        ESP.restart();
+    }
+    delay(100);
+}
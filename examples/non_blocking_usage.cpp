@@ -0,0 +1,33 @@
+#include <WiFiProvisioner.h>
+#include <WiFi.h>
+
+WiFiProvisioner provisioner("My Device Setup");
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("Starting WiFi Provisioning...");
+
+    // Called from provisioner.loop() once the user submits the form, or
+    // with success == false if Config::PORTAL_TIMEOUT_MS runs out
+    provisioner.onCredentials([](const WiFiCredentials& creds) {
+        if (!creds.success) {
+            Serial.printf("Provisioning failed: %s\n", creds.error.c_str());
+            return;
+        }
+        Serial.printf("Got credentials for SSID: %s\n", creds.ssid.c_str());
+        WiFi.begin(creds.ssid.c_str(), creds.password.c_str());
+    });
+
+    if (!provisioner.begin()) {
+        Serial.printf("Failed to start the provisioning portal: %s\n", provisioner.lastError().c_str());
+    }
+}
+
+void loop() {
+    // Keeps the portal responsive; returns immediately when it isn't running
+    provisioner.loop();
+
+    // The rest of your application keeps running while the portal is up
+}
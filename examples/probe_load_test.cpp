@@ -0,0 +1,250 @@
+// Load test for the portal's HTTP and DNS paths, using two boards.
+//
+// Flash one board with PROBE_ROLE_PORTAL 1: it runs the portal and prints
+// getStats() every few seconds. Flash a second board with PROBE_ROLE_PORTAL 0:
+// it joins the portal's AP as a station and replays the probe sequences
+// iOS, Android and Windows send on joining, PROBE_RATE_HZ bursts a second
+// with each burst's requests in parallel, then reports p50/p99 latency and
+// DNS and HTTP failures separately per round.
+
+#include <WiFiProvisioner.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <algorithm>
+#include <atomic>
+
+#ifndef PROBE_ROLE_PORTAL
+#define PROBE_ROLE_PORTAL 1
+#endif
+
+static const char* AP_NAME = "ESP32 Wi-Fi Setup";
+
+#if PROBE_ROLE_PORTAL
+
+WiFiProvisioner provisioner(AP_NAME);
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    provisioner.getConfig().ENABLE_METRICS = true;
+    if (!provisioner.begin()) {
+        Serial.println("Failed to start the provisioning portal");
+    }
+}
+
+void loop() {
+    provisioner.loop();
+
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport >= 5000) {
+        lastReport = millis();
+        WiFiProvisioner::Stats stats = provisioner.getStats();
+        Serial.printf("http %lu req, max %lu us | dns %lu | min free heap %u\n",
+                      (unsigned long)stats.httpRequests, (unsigned long)stats.maxHttpMicros,
+                      (unsigned long)stats.dnsQueries, (unsigned)provisioner.getHeapStats().minFree);
+    }
+}
+
+#else // Probe client
+
+#ifndef PROBE_RATE_HZ
+#define PROBE_RATE_HZ 2   // Bursts per second, i.e. devices joining
+#endif
+
+static const size_t SAMPLES_PER_ROUND = 200;
+
+struct Probe { const char* host; const char* path; };
+
+// What each OS looks up and fetches right after joining a network. The
+// requests of one burst go out at once, each on its own connection, as
+// the OS itself sends them.
+static const Probe IOS_PROBES[] = {
+    {"captive.apple.com", "/hotspot-detect.html"},
+    {"www.apple.com", "/library/test/success.html"},
+};
+static const Probe ANDROID_PROBES[] = {
+    {"connectivitycheck.gstatic.com", "/generate_204"},
+    {"www.google.com", "/gen_204"},
+    {"clients3.google.com", "/generate_204"},
+};
+static const Probe WINDOWS_PROBES[] = {
+    {"www.msftconnecttest.com", "/connecttest.txt"},
+    {"www.msftncsi.com", "/ncsi.txt"},
+};
+
+static const struct { const Probe* probes; size_t count; } BURSTS[] = {
+    {IOS_PROBES, sizeof(IOS_PROBES) / sizeof(IOS_PROBES[0])},
+    {ANDROID_PROBES, sizeof(ANDROID_PROBES) / sizeof(ANDROID_PROBES[0])},
+    {WINDOWS_PROBES, sizeof(WINDOWS_PROBES) / sizeof(WINDOWS_PROBES[0])},
+};
+
+enum ProbeOutcome { PROBE_OK, PROBE_DNS_FAILED, PROBE_HTTP_FAILED };
+
+struct ProbeResult {
+    ProbeOutcome outcome;
+    uint32_t micros;   // DNS lookup plus HTTP request, when PROBE_OK
+};
+
+static QueueHandle_t results;
+static size_t probesInFlight = 0;  // Only touched from loop()
+
+static uint32_t latencies[SAMPLES_PER_ROUND];
+static size_t sampleCount = 0;
+static size_t dnsFailures = 0;
+static size_t httpFailures = 0;
+
+// Sends an A query straight to the portal. WiFi.hostByName() would answer
+// repeats from lwIP's cache and never reach the DNS responder under test.
+// Each probe has its own socket, so concurrent lookups don't see each
+// other's answers.
+static bool lookup(const char* host, IPAddress& address) {
+    static std::atomic<uint16_t> nextId(0);
+    WiFiUDP udp;
+    uint16_t id = ++nextId;
+    uint8_t packet[128] = {0};
+
+    packet[0] = id >> 8;
+    packet[1] = id & 0xFF;
+    packet[2] = 0x01;  // Recursion desired
+    packet[5] = 1;     // One question
+    size_t length = 12;
+    for (const char* label = host; *label && length < sizeof(packet) - 6;) {
+        const char* dot = strchr(label, '.');
+        size_t labelLength = dot ? (size_t)(dot - label) : strlen(label);
+        packet[length++] = labelLength;
+        memcpy(packet + length, label, labelLength);
+        length += labelLength;
+        label += labelLength + (dot ? 1 : 0);
+    }
+    length++;                  // Root label
+    packet[length + 1] = 1;    // Type A
+    packet[length + 3] = 1;    // Class IN
+    length += 4;
+
+    udp.beginPacket(WiFi.gatewayIP(), 53);
+    udp.write(packet, length);
+    udp.endPacket();
+
+    unsigned long start = millis();
+    while (millis() - start < 1000) {
+        int received = udp.parsePacket();
+        if (received >= 16) {
+            received = udp.read(packet, sizeof(packet));
+            // Matching ID and at least one answer; its address ends the packet
+            if (received >= 16 && packet[0] == (id >> 8) && packet[1] == (id & 0xFF) && packet[7] > 0) {
+                address = IPAddress(packet[received - 4], packet[received - 3],
+                                    packet[received - 2], packet[received - 1]);
+                udp.stop();
+                return true;
+            }
+        }
+        delay(1);
+    }
+    udp.stop();
+    return false;
+}
+
+// DNS lookup plus one HTTP request
+static ProbeResult runProbe(const Probe& probe) {
+    uint32_t start = micros();
+
+    IPAddress address;
+    if (!lookup(probe.host, address)) {
+        return {PROBE_DNS_FAILED, 0};
+    }
+
+    WiFiClient client;
+    if (!client.connect(address, 80, 1000)) {
+        return {PROBE_HTTP_FAILED, 0};
+    }
+    client.printf("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", probe.path, probe.host);
+
+    // Only the status line matters; the portal answers probes with a redirect
+    client.setTimeout(1000);
+    String status = client.readStringUntil('\n');
+    client.stop();
+
+    if (!status.startsWith("HTTP/1.")) {
+        return {PROBE_HTTP_FAILED, 0};
+    }
+    uint32_t elapsed = micros() - start;
+    return {PROBE_OK, elapsed};
+}
+
+static void probeTask(void* arg) {
+    ProbeResult result = runProbe(*static_cast<const Probe*>(arg));
+    xQueueSend(results, &result, portMAX_DELAY);
+    vTaskDelete(nullptr);
+}
+
+static void startBurst(const Probe* probes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // Out of memory on this side says nothing about the portal
+        if (xTaskCreate(probeTask, "probe", 4096, const_cast<Probe*>(&probes[i]), 1, nullptr) != pdPASS) {
+            Serial.println("Could not start a probe task");
+            break;
+        }
+        probesInFlight++;
+    }
+}
+
+static void report() {
+    std::sort(latencies, latencies + sampleCount);
+    uint32_t p50 = sampleCount ? latencies[sampleCount / 2] : 0;
+    uint32_t p99 = sampleCount ? latencies[(sampleCount * 99) / 100] : 0;
+    Serial.printf("%u ok, %u DNS failed, %u HTTP failed | p50 %lu us | p99 %lu us\n",
+                  (unsigned)sampleCount, (unsigned)dnsFailures, (unsigned)httpFailures,
+                  (unsigned long)p50, (unsigned long)p99);
+    sampleCount = 0;
+    dnsFailures = 0;
+    httpFailures = 0;
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    results = xQueueCreate(16, sizeof(ProbeResult));
+
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(AP_NAME);
+    Serial.printf("Joining %s", AP_NAME);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(250);
+        Serial.print(".");
+    }
+    Serial.printf("\nConnected, sending %d probe bursts per second\n", PROBE_RATE_HZ);
+}
+
+void loop() {
+    static size_t next = 0;
+    static unsigned long lastBurst = 0;
+
+    ProbeResult result;
+    while (xQueueReceive(results, &result, 0) == pdTRUE) {
+        probesInFlight--;
+        if (result.outcome == PROBE_OK && sampleCount < SAMPLES_PER_ROUND) {
+            latencies[sampleCount++] = result.micros;
+        } else if (result.outcome == PROBE_DNS_FAILED) {
+            dnsFailures++;
+        } else if (result.outcome == PROBE_HTTP_FAILED) {
+            httpFailures++;
+        }
+    }
+
+    if (sampleCount + dnsFailures + httpFailures >= SAMPLES_PER_ROUND) {
+        report();
+    }
+
+    // Bursts overlap like devices joining close together, up to a limit
+    // that keeps this board's own sockets from becoming the bottleneck
+    if (millis() - lastBurst >= 1000 / PROBE_RATE_HZ && probesInFlight < 8) {
+        lastBurst = millis();
+        const auto& burst = BURSTS[next++ % (sizeof(BURSTS) / sizeof(BURSTS[0]))];
+        startBurst(burst.probes, burst.count);
+    }
+    delay(1);
+}
+
+#endif
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Compile a portal page into a header that WiFiProvisioner serves from flash.
+
+The page is split at its {{PLACEHOLDER}} markers here, exactly as
+HtmlTemplate::split() does at runtime, so the device gets the literal text,
+the segment table and, for pages without placeholders, the ETag ready-made.
+
+    python3 extras/embed_template.py data/wifiportal.html src/wifiportal_page.h \
+        --minify --gzip
+
+Then in the sketch:
+
+    #include "wifiportal_page.h"
+    provisioner.getConfig().EMBEDDED_PAGE = &wifiportal_page;
+
+With --gzip a compressed copy is embedded too and sent to clients that
+accept it. Placeholders are not filled in the compressed copy, so only use
+it for pages without them.
+"""
+
+import argparse
+import gzip
+import re
+import sys
+
+# Must match the order of HtmlTemplate::Slot in src/internal/html_template.h
+SLOTS = [
+    "NONE",
+    "NETWORKS_LIST",
+    "HTML_TITLE",
+    "THEME_COLOR",
+    "SVG_LOGO",
+    "PROJECT_TITLE",
+    "PROJECT_SUB_TITLE",
+    "PROJECT_INFO",
+    "FOOTER_TEXT",
+    "CONNECTION_SUCCESSFUL",
+]
+
+# Default of WIFI_PROV_MAX_TEMPLATE_SEGMENTS
+MAX_SEGMENTS = 24
+
+
+def minify(html):
+    # Comments and indentation only; text inside tags is left alone
+    html = re.sub(rb"<!--(?!\[).*?-->", b"", html, flags=re.S)
+    lines = (line.strip() for line in html.splitlines())
+    return b"\n".join(line for line in lines if line)
+
+
+def split(data, max_segments):
+    """Returns [(offset, length, slot)], mirroring HtmlTemplate::split()."""
+    tokens = {("{{%s}}" % name).encode(): index for index, name in enumerate(SLOTS) if index}
+    segments = []
+    literal_start = pos = 0
+
+    # The last segment holds the trailing literal
+    while pos + 1 < len(data) and len(segments) < max_segments - 1:
+        match = None
+        if data[pos:pos + 2] == b"{{":
+            match = next((t for t in tokens if data.startswith(t, pos)), None)
+        if not match:
+            pos += 1
+            continue
+        segments.append((literal_start, pos - literal_start, tokens[match]))
+        pos += len(match)
+        literal_start = pos
+
+    segments.append((literal_start, len(data) - literal_start, 0))
+    return segments
+
+
+def fnv1a(data):
+    # Same digest as DigestResponseWriter
+    digest = 2166136261
+    for byte in data:
+        digest = ((digest ^ byte) * 16777619) & 0xFFFFFFFF
+    return '"%08x"' % digest
+
+
+def c_string(data, width=96):
+    out, line = [], ""
+    for byte in data:
+        char = chr(byte)
+        if char in '"\\?':
+            piece = "\\" + char
+        elif char == "\n":
+            piece = "\\n"
+        elif 0x20 <= byte < 0x7F:
+            piece = char
+        else:
+            piece = "\\%03o" % byte  # Octal never swallows the next character
+        line += piece
+        if len(line) >= width or char == "\n":
+            out.append('  "%s"' % line)
+            line = ""
+    if line:
+        out.append('  "%s"' % line)
+    return "\n".join(out) if out else '  ""'
+
+
+def c_bytes(data, per_line=16):
+    rows = []
+    for i in range(0, len(data), per_line):
+        rows.append("  " + ", ".join("0x%02x" % b for b in data[i:i + per_line]) + ",")
+    return "\n".join(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("input", help="HTML page, e.g. data/wifiportal.html")
+    parser.add_argument("output", help="header to write")
+    parser.add_argument("--name", default="wifiportal", help="prefix for the generated symbols")
+    parser.add_argument("--minify", action="store_true", help="strip comments and indentation")
+    parser.add_argument("--gzip", action="store_true", help="also embed a gzipped copy")
+    parser.add_argument("--max-segments", type=int, default=MAX_SEGMENTS,
+                        help="WIFI_PROV_MAX_TEMPLATE_SEGMENTS of the build")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+    if args.minify:
+        data = minify(data)
+    if not data:
+        sys.exit("%s is empty" % args.input)
+
+    segments = split(data, args.max_segments)
+    has_slots = any(slot for _, _, slot in segments)
+    compressed = gzip.compress(data, 9, mtime=0) if args.gzip else None
+    if compressed and has_slots:
+        print("warning: %s has placeholders; the gzipped copy is served unfilled" % args.input,
+              file=sys.stderr)
+
+    name = args.name
+    guard = re.sub(r"\W", "_", name).upper() + "_PAGE_H"
+    rows = "\n".join("  {%u, %u, %u},  // then %s" % (offset, length, slot, SLOTS[slot])
+                     for offset, length, slot in segments)
+
+    lines = [
+        "// Generated by extras/embed_template.py from %s; do not edit." % args.input,
+        "#ifndef %s" % guard,
+        "#define %s" % guard,
+        "",
+        "#include <WiFiProvisioner.h>",
+        "",
+        "static const char %s_html[] PROGMEM =" % name,
+        c_string(data) + ";",
+        "",
+        "static const uint32_t %s_segments[][3] PROGMEM = {" % name,
+        rows,
+        "};",
+        "",
+    ]
+    if compressed:
+        lines += [
+            "static const uint8_t %s_gzip[] PROGMEM = {" % name,
+            c_bytes(compressed),
+            "};",
+            "",
+        ]
+    lines += [
+        "static const EmbeddedPage %s_page = {" % name,
+        "  %s_html, %u," % (name, len(data)),
+        "  %s_segments, %u," % (name, len(segments)),
+        "  %s," % ('"\\"%s\\""' % fnv1a(data)[1:-1] if not has_slots else "nullptr"),
+        ("  %s_gzip, %u, \"\\\"%s\\\"\"" % (name, len(compressed), fnv1a(compressed)[1:-1])
+         if compressed else "  nullptr, 0, nullptr"),
+        "};",
+        "",
+        "#endif // %s" % guard,
+        "",
+    ]
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines))
+
+    print("%s: %u bytes, %u segments%s" % (args.output, len(data), len(segments),
+          ", %u bytes gzipped" % len(compressed) if compressed else ""))
+
+
+if __name__ == "__main__":
+    main()
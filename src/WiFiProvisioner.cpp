@@ -1,366 +1,1590 @@
 #include "WiFiProvisioner.h"
-#include <WebServer.h>
-#include <DNSServer.h>
+#include "internal/html_template.h"
+#include "internal/response_writer.h"
+#include "internal/scan_cache.h"
+#include "internal/portal_server.h"
+#include "internal/captive_dns.h"
+#include "internal/provision_html.h"
+#include "internal/credential_store.h"
+#include "internal/portal_fs.h"
+#include "internal/fanout_link.h"
+#include "internal/secure_wipe.h"
+#include "internal/fixed_responses.h"
 #include <WiFi.h>
-#include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include <lwip/sockets.h>
+#include <esp_wifi.h>
+#include <new>
+
+// Serial logging, chosen at compile time so disabled levels cost nothing:
+//   0 - off
+//   1 - warnings and failures
+//   2 - everything, including per-request tracing
+#ifndef WIFI_PROV_LOG_LEVEL
+#define WIFI_PROV_LOG_LEVEL 1
+#endif
 
-#define DEBUG_WIFI_PROV 1
+#if WIFI_PROV_LOG_LEVEL >= 1
+#define WARN_LOG(fmt, ...) Serial.printf("[WiFiProv] " fmt "\n", ##__VA_ARGS__)
+#else
+#define WARN_LOG(fmt, ...)
+#endif
 
-#if DEBUG_WIFI_PROV
+#if WIFI_PROV_LOG_LEVEL >= 2
 #define DEBUG_LOG(fmt, ...) Serial.printf("[WiFiProv] " fmt "\n", ##__VA_ARGS__)
 #else
 #define DEBUG_LOG(fmt, ...)
 #endif
 
+static const char SCANNING_HTML[] PROGMEM =
+  "<div class=\"scanning\">📶 Scanning for networks... <div class=\"spinner\"></div></div>";
+
+// JsonDocument allocator that wipes every block before freeing it, for
+// documents holding credentials. Each block records its size up front.
+class WipingAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    size_t* block = static_cast<size_t*>(malloc(sizeof(size_t) + size));
+    if (!block) {
+      return nullptr;
+    }
+    *block = size;
+    return block + 1;
+  }
+
+  void deallocate(void* pointer) override {
+    if (!pointer) {
+      return;
+    }
+    size_t* block = static_cast<size_t*>(pointer) - 1;
+    secureWipe(block, sizeof(size_t) + *block);
+    free(block);
+  }
+
+  // Never realloc() in place, which would leave the old bytes behind
+  void* reallocate(void* pointer, size_t size) override {
+    void* moved = allocate(size);
+    if (moved && pointer) {
+      size_t oldSize = *(static_cast<size_t*>(pointer) - 1);
+      memcpy(moved, pointer, oldSize < size ? oldSize : size);
+      deallocate(pointer);
+    }
+    return moved;
+  }
+};
+
 WiFiProvisioner::WiFiProvisioner(const char* apName)
-  : _apName(apName), _server(nullptr), _dnsServer(nullptr),
+  : _apName(apName), _server(nullptr), _dnsServer(nullptr), _template(nullptr), _gzipPage(nullptr),
     _apIP(192, 168, 4, 1), _netMask(255, 255, 255, 0),
-    _credentialsReceived(false), _lastScanTime(0) {
+    _running(false), _credentialsReceived(false), _credentialsSeenAt(0),
+    _task(nullptr), _taskDone(nullptr), _taskExited(false), _pumpTask(nullptr),
+    _stationEventId(0), _portalStartedAt(0),
+    _heapStats(), _heapLowWaterAtStart(0), _heapBudget(0), _stats(),
+    _statsLock(portMUX_INITIALIZER_UNLOCKED), _heapSnapshot(), _statsSnapshot(), _scanStartedAt(0),
+    _scanCache(nullptr), _fanout(nullptr), _scanRefreshRequested(false), _scanPass(0), _scanStaged(false),
+    _verifyState(VERIFY_IDLE), _verifyStep(VERIFY_STEP_NONE), _verifyReason(""), _verifyStartedAt(0) {
 
   DEBUG_LOG("WiFiProvisioner initialized with AP name: %s", _apName);
 }
 
 WiFiProvisioner::~WiFiProvisioner() {
-  releaseResources();
+  end();
 }
 
-WiFiCredentials WiFiProvisioner::getCredentials() {
+bool WiFiProvisioner::begin() {
+  if (_running) {
+    return true;
+  }
+
   DEBUG_LOG("Starting credential collection process...");
 
   // Reset state
   _credentialsReceived = false;
+  _credentialsSeenAt = 0;
   _credentials = {"", "", false, ""};
+  _verifyState = VERIFY_IDLE;
+  _verifyStep = VERIFY_STEP_NONE;
+  _heapStats = {ESP.getFreeHeap(), ESP.getFreeHeap(), ESP.getMaxAllocHeap(), 0, 0};
+  _heapLowWaterAtStart = ESP.getMinFreeHeap();
+  _stats = Stats();
+  _scanStartedAt = 0;
+  _scanPass = 0;
+  _scanStaged = false;
+  _portalStartedAt = millis();
+  _heapBudget = _config.HEAP_BUDGET;
+  if (_heapBudget && _heapStats.freeAtStart < _heapBudget) {
+    WARN_LOG("Only %u bytes free, lowering the %u byte heap budget to that",
+             (unsigned)_heapStats.freeAtStart, (unsigned)_heapBudget);
+    _heapBudget = _heapStats.freeAtStart;
+  }
 
   // Setup Access Point and servers
-  setupAP();
-  startServers();
+  if (!setupAP()) {
+    _credentials.error = "Failed to start Access Point";
+    releaseResources();
+    return false;
+  }
+  if (!startServers()) {
+    _credentials.error = "Not enough memory for the portal";
+    releaseResources();
+    return false;
+  }
+
+  publishStats();
+  _running = true;
+  return true;
+}
+
+void WiFiProvisioner::loop() {
+  if (!_running || _task || !pollPortal()) {
+    return;
+  }
 
-  DEBUG_LOG("Entering blocking loop, waiting for credentials...");
+  if (_onCredentials) {
+    _onCredentials(_credentials);
+  }
+  // The callback had its chance to copy them; don't keep them around
+  _credentials.ssid.clear();
+  _credentials.password.clear();
+}
+
+bool WiFiProvisioner::pollPortal() {
+  // One pass of the caller-driven pump; true once the portal has ended
+  handleClient();
 
-  // Blocking loop until credentials are received
-  while (!_credentialsReceived) {
-    handleClient();
-    delay(10);  // Small delay to prevent watchdog timeout
+  bool timedOut = checkPortalTimeout();
+  if (!timedOut && !credentialsComplete()) {
+    return false;
+  }
+
+  DEBUG_LOG("%s, cleaning up...", timedOut ? "Portal timed out" : "Credentials received");
+  end();
+  return true;
+}
+
+void WiFiProvisioner::end() {
+  if (!_running) {
+    return;
+  }
+
+  if (_task) {
+    // Called from the portal task itself (e.g. in onCredentials); it is exiting anyway
+    if (xTaskGetCurrentTaskHandle() == _task) {
+      return;
+    }
+
+    // Already done, e.g. it delivered to onCredentials() and nobody waited
+    if (reapPortalTask()) {
+      return;
+    }
+
+    // Ask the portal task to stop and wait until it has cleaned up
+    bool received = false;
+    xTaskNotify(_task, TASK_STOP_BIT, eSetBits);
+    xQueueReceive(_taskDone, &received, portMAX_DELAY);
+    collectPortalTask();
+    return;
   }
 
-  DEBUG_LOG("Credentials received, cleaning up...");
   releaseResources();
+  _running = false;
+}
+
+bool WiFiProvisioner::beginTask(uint32_t stackSize, UBaseType_t priority, BaseType_t core) {
+  if (_running && !(_task && reapPortalTask())) {
+    return _task != nullptr;
+  }
+
+  _taskDone = xQueueCreate(1, sizeof(bool));
+  if (!_taskDone) {
+    return false;
+  }
 
-  return _credentials;
+  if (!begin()) {
+    vQueueDelete(_taskDone);
+    _taskDone = nullptr;
+    return false;
+  }
+
+  _taskExited = false;
+  BaseType_t result = xTaskCreatePinnedToCore(portalTask, "wifi_prov", stackSize, this, priority,
+                                              &_task, core < 0 ? tskNO_AFFINITY : core);
+  if (result != pdPASS) {
+    WARN_LOG("Failed to create portal task");
+    _task = nullptr;
+    vQueueDelete(_taskDone);
+    _taskDone = nullptr;
+    end();
+    return false;
+  }
+
+  DEBUG_LOG("Portal task started (priority %u, core %d)", priority, core);
+  return true;
 }
 
-void WiFiProvisioner::setupAP() {
+bool WiFiProvisioner::waitForCredentials(WiFiCredentials& credentials, TickType_t timeout) {
+  if (!_task) {
+    return false;
+  }
+
+  bool received = false;
+  if (xQueueReceive(_taskDone, &received, timeout) != pdTRUE) {
+    return false;
+  }
+
+  collectPortalTask();
+  takeCredentials(credentials);
+  return received;
+}
+
+void WiFiProvisioner::portalTask(void* arg) {
+  WiFiProvisioner* self = static_cast<WiFiProvisioner*>(arg);
+
+  // Pump the portal, sleeping between passes as waitForWork() decides. A
+  // stop request from end() wakes the task immediately.
+  self->_pumpTask = xTaskGetCurrentTaskHandle();
+  bool timedOut = false;
+  while (!self->credentialsComplete()) {
+    self->handleClient();
+    timedOut = self->checkPortalTimeout();
+    if (timedOut || (self->waitForWork() & TASK_STOP_BIT)) {
+      break;
+    }
+  }
+
+  bool received = self->_credentialsReceived;
+  self->releaseResources();
+
+  // Stopped by end(), nobody is waiting for a result
+  if (received || timedOut) {
+    DEBUG_LOG("%s on portal task", received ? "Credentials received" : "Portal timed out");
+    if (self->_onCredentials) {
+      self->_onCredentials(self->_credentials);
+    }
+  }
+
+  // The queue hands the result, and ownership of _credentials, back to the owner
+  self->_taskExited = true;
+  xQueueSend(self->_taskDone, &received, portMAX_DELAY);
+  vTaskSuspend(nullptr);
+}
+
+bool WiFiProvisioner::reapPortalTask() {
+  // Collects a task that finished without waitForCredentials() being called
+  bool received = false;
+  if (xQueueReceive(_taskDone, &received, 0) != pdTRUE) {
+    return false;
+  }
+  collectPortalTask();
+  return true;
+}
+
+void WiFiProvisioner::collectPortalTask() {
+  vTaskDelete(_task);
+  vQueueDelete(_taskDone);
+  _taskDone = nullptr;
+  _task = nullptr;
+  _running = false;
+}
+
+bool WiFiProvisioner::credentialsComplete() {
+  if (!_credentialsReceived) {
+    return false;
+  }
+
+#if WIFI_PROV_ASYNC_SERVER
+  // The async server may still be sending the final response when the flag
+  // is set, so give it a moment before the server is torn down
+  if (_credentialsSeenAt == 0) {
+    _credentialsSeenAt = millis() | 1;
+  }
+  // A verified /configure answer is only sent when the AsyncTCP task next
+  // polls it, so also wait for open responses, within a bound
+  unsigned long elapsed = millis() - _credentialsSeenAt;
+  return (elapsed >= ASYNC_RESPONSE_GRACE && !_server->isStreaming()) ||
+         elapsed >= ASYNC_RESPONSE_TIMEOUT;
+#else
+  return true;
+#endif
+}
+
+bool WiFiProvisioner::checkPortalTimeout() {
+  if (_config.PORTAL_TIMEOUT_MS == 0 || _credentialsReceived ||
+      millis() - _portalStartedAt < _config.PORTAL_TIMEOUT_MS) {
+    return false;
+  }
+
+  // A join in progress may still produce credentials, so let it finish
+  uint8_t state = _verifyState;
+  if (state == VERIFY_REQUESTED || state == VERIFY_RUNNING) {
+    return false;
+  }
+
+  WARN_LOG("No credentials after %lu ms, closing the portal", _config.PORTAL_TIMEOUT_MS);
+  _credentials.success = false;
+  _credentials.error = "Portal timed out";
+  return true;
+}
+
+bool WiFiProvisioner::portalIdle() {
+  // With nobody associated and no join to drive there is nothing to serve
+  uint8_t state = _verifyState;
+  return !_credentialsReceived && state != VERIFY_REQUESTED && state != VERIFY_RUNNING &&
+         WiFi.softAPgetStationNum() == 0;
+}
+
+uint32_t WiFiProvisioner::waitForWork() {
+  // Blocked here, the CPU idles; with power management and tickless idle
+  // enabled in the SDK config it can also drop its clock meanwhile
+  uint32_t notification = 0;
+  if (_config.IDLE_POLL_MS == 0) {
+    xTaskNotifyWait(0, TASK_STOP_BIT | STATION_JOINED_BIT, &notification, 1);
+    return notification;
+  }
+
+  if (portalIdle()) {
+    // Woken early when a station joins or end() stops the task
+    TickType_t ticks = pdMS_TO_TICKS(_config.IDLE_POLL_MS);
+    xTaskNotifyWait(0, TASK_STOP_BIT | STATION_JOINED_BIT, &notification, ticks > 0 ? ticks : 1);
+    return notification;
+  }
+
+  // A client is around. Sleep until its next DNS query, but no longer than
+  // CLIENT_POLL_MS: the web server, the scan and the join have nothing to
+  // wait on and are polled from the next pass.
+  int dnsSocket = _dnsServer ? _dnsServer->socket() : -1;
+  if (dnsSocket >= 0) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(dnsSocket, &readable);
+    struct timeval timeout = {0, static_cast<long>(CLIENT_POLL_MS * 1000)};
+    select(dnsSocket + 1, &readable, nullptr, nullptr, &timeout);
+  } else {
+    vTaskDelay(pdMS_TO_TICKS(CLIENT_POLL_MS));
+  }
+  // A stop request from end() arrives as a notification, not on the socket
+  xTaskNotifyWait(0, TASK_STOP_BIT | STATION_JOINED_BIT, &notification, 0);
+  return notification;
+}
+
+void WiFiProvisioner::wakePump() {
+  TaskHandle_t task = _pumpTask;
+  if (task) {
+    xTaskNotify(task, STATION_JOINED_BIT, eSetBits);
+  }
+}
+
+void WiFiProvisioner::onCredentials(CredentialsCallback callback) {
+  _onCredentials = callback;
+}
+
+WiFiCredentials WiFiProvisioner::getCredentials() {
+  WiFiCredentials credentials;
+  if (begin()) {
+    DEBUG_LOG("Entering blocking loop, waiting for credentials...");
+
+    // Blocking between passes also lets the idle task feed the watchdog
+    _pumpTask = xTaskGetCurrentTaskHandle();
+    while (_running && !pollPortal()) {
+      waitForWork();
+    }
+    _pumpTask = nullptr;
+  }
+
+  // Returned in place, so this is the only copy left
+  takeCredentials(credentials);
+  return credentials;
+}
+
+void WiFiProvisioner::takeCredentials(WiFiCredentials& credentials) {
+  credentials = _credentials;
+  _credentials.ssid.clear();
+  _credentials.password.clear();
+}
+
+WiFiCredentials WiFiProvisioner::connectOrProvision() {
+  CredentialStore store(_config.STORAGE_NAMESPACE);
+  StoredNetwork stored;
+  bool haveStored = store.load(stored);
+
+  if (haveStored) {
+    DEBUG_LOG("Trying stored network '%s' (channel %u)", stored.ssid, stored.channel);
+
+    // Pinning the channel and BSSID lets the driver skip its scan. If the
+    // access point moved, fall back to a normal association once.
+    bool connected = connectStation(stored.ssid, stored.password, stored.channel,
+                                    stored.hasBssid ? stored.bssid : nullptr);
+    if (!connected && (stored.hasBssid || stored.channel)) {
+      connected = connectStation(stored.ssid, stored.password, 0, nullptr);
+    }
+
+    if (connected) {
+      rememberNetwork(store, &stored, stored.ssid, stored.password);
+      WiFiCredentials credentials;
+      credentials.ssid = stored.ssid;
+      credentials.password = stored.password;
+      credentials.success = true;
+      secureWipe(&stored, sizeof(stored));
+      return credentials;
+    }
+    DEBUG_LOG("Stored network unavailable, starting portal");
+  }
+
+  WiFiCredentials credentials = getCredentials();
+  if (!credentials.success) {
+    secureWipe(&stored, sizeof(stored));
+    return credentials;
+  }
+
+  // A verified portal leaves the station connected already
+  bool connected = WiFi.status() == WL_CONNECTED && WiFi.SSID() == credentials.ssid;
+  if (!connected && !connectStation(credentials.ssid.c_str(), credentials.password.c_str(), 0, nullptr)) {
+    credentials.success = false;
+    credentials.error = "Could not connect to the provisioned network";
+    secureWipe(&stored, sizeof(stored));
+    return credentials;
+  }
+
+  rememberNetwork(store, haveStored ? &stored : nullptr, credentials.ssid.c_str(), credentials.password.c_str());
+  secureWipe(&stored, sizeof(stored));
+  return credentials;
+}
+
+size_t WiFiProvisioner::shareCredentials(const WiFiCredentials& credentials, unsigned long durationMs) {
+  if (_running || !credentials.success || !_config.FANOUT_KEY) {
+    return 0;
+  }
+
+  FanoutLink link;
+  if (!link.begin(FanoutLink::COORDINATOR, _config.FANOUT_KEY, false)) {
+    WARN_LOG("Failed to start fan-out coordinator");
+    return 0;
+  }
+
+  DEBUG_LOG("Sharing credentials for '%s' for %lu ms", credentials.ssid.c_str(), durationMs);
+  unsigned long start = millis();
+  while (millis() - start < durationMs) {
+    link.pollCoordinator(credentials.ssid.c_str(), credentials.password.c_str());
+    delay(10);
+  }
+
+  size_t served = link.served();
+  link.end();
+  DEBUG_LOG("Credentials shared with %u devices", (unsigned)served);
+  return served;
+}
+
+void WiFiProvisioner::pollFanout() {
+  char ssid[33];
+  char password[65];
+  if (!_fanout->pollReceiver(ssid, sizeof(ssid), password, sizeof(password))) {
+    return;
+  }
+
+  DEBUG_LOG("Received credentials for '%s' over fan-out", ssid);
+  if (!_config.VERIFY_CONNECTION) {
+    acceptCredentials(ssid, password);
+  } else if (!requestVerification(ssid, password)) {
+    DEBUG_LOG("Connection attempt already in progress, ignoring them");
+  }
+  secureWipe(password, sizeof(password));
+}
+
+void WiFiProvisioner::forgetCredentials() {
+  CredentialStore(_config.STORAGE_NAMESPACE).clear();
+}
+
+bool WiFiProvisioner::connectStation(const char* ssid, const char* password,
+                                     int32_t channel, const uint8_t* bssid) {
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password, channel, bssid);
+
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= _config.CONNECT_TIMEOUT_MS) {
+      WARN_LOG("Connecting to '%s' timed out", ssid);
+      WiFi.disconnect();
+      return false;
+    }
+    delay(50);
+  }
+
+  DEBUG_LOG("Connected to '%s' on channel %ld", ssid, (long)WiFi.channel());
+  return true;
+}
+
+void WiFiProvisioner::rememberNetwork(CredentialStore& store, const StoredNetwork* previous,
+                                      const char* ssid, const char* password) {
+  StoredNetwork network;
+  memset(&network, 0, sizeof(network));
+  strlcpy(network.ssid, ssid, sizeof(network.ssid));
+  strlcpy(network.password, password, sizeof(network.password));
+  network.channel = static_cast<uint8_t>(WiFi.channel());
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid) {
+    memcpy(network.bssid, bssid, sizeof(network.bssid));
+    network.hasBssid = true;
+  }
+
+  // Only touch flash when something changed, e.g. after roaming
+  if (!previous || memcmp(previous, &network, sizeof(network)) != 0) {
+    if (!store.save(network)) {
+      WARN_LOG("Failed to save network to NVS");
+    }
+  }
+  secureWipe(&network, sizeof(network));
+}
+
+WiFiProvisioner::Stats WiFiProvisioner::getStats() const {
+  portENTER_CRITICAL(&_statsLock);
+  Stats stats = _statsSnapshot;
+  portEXIT_CRITICAL(&_statsLock);
+  return stats;
+}
+
+WiFiProvisioner::HeapStats WiFiProvisioner::getHeapStats() const {
+  portENTER_CRITICAL(&_statsLock);
+  HeapStats heap = _heapSnapshot;
+  portEXIT_CRITICAL(&_statsLock);
+  return heap;
+}
+
+void WiFiProvisioner::publishStats() {
+  // Runs on the task pumping the portal, the only one that touches _server
+  // and the live counters; other tasks only ever read the copies
+  if (_server) {
+    _stats.httpRequests = _server->requestCount();
+    _stats.httpMicros = _server->handlerMicros();
+    _stats.maxHttpMicros = _server->maxHandlerMicros();
+  }
+
+  portENTER_CRITICAL(&_statsLock);
+  _statsSnapshot = _stats;
+  _heapSnapshot = _heapStats;
+  portEXIT_CRITICAL(&_statsLock);
+}
+
+void WiFiProvisioner::trackAllocation(size_t bytes) {
+  _heapStats.allocated += bytes;
+  if (bytes > _heapStats.largestAllocation) {
+    _heapStats.largestAllocation = bytes;
+  }
+}
+
+size_t WiFiProvisioner::remainingBudget() const {
+  if (!_heapBudget) {
+    return 0;  // Unbounded
+  }
+  // 1 rather than 0 so nothing more fits once the budget is used up
+  return _heapStats.allocated < _heapBudget ? _heapBudget - _heapStats.allocated : 1;
+}
+
+bool WiFiProvisioner::fitsBudget(size_t bytes) const {
+  return !_heapBudget || _heapStats.allocated + bytes <= _heapBudget;
+}
+
+void WiFiProvisioner::sampleHeap() {
+  size_t freeHeap = ESP.getFreeHeap();
+  // The allocator's low-water mark also catches dips between samples, but it
+  // counts since boot; it only speaks for this session once it drops below
+  // where it stood at begin()
+  size_t lowWater = ESP.getMinFreeHeap();
+  if (lowWater < _heapLowWaterAtStart && lowWater < freeHeap) {
+    freeHeap = lowWater;
+  }
+  if (freeHeap < _heapStats.minFree) {
+    _heapStats.minFree = freeHeap;
+  }
+  size_t largestBlock = ESP.getMaxAllocHeap();
+  if (largestBlock < _heapStats.minLargestFreeBlock) {
+    _heapStats.minLargestFreeBlock = largestBlock;
+  }
+}
+
+bool WiFiProvisioner::setupAP() {
   DEBUG_LOG("Setting up Access Point...");
 
-  // Disconnect from any existing connections
-  WiFi.disconnect(true);
-  delay(100);
+  // Drop any station association but keep the radio running, and only
+  // switch modes when needed. Mode changes complete synchronously, so no
+  // settling delays are required.
+  WiFi.disconnect(false);
+  if (WiFi.getMode() != WIFI_AP_STA && !WiFi.mode(WIFI_AP_STA)) {
+    WARN_LOG("Failed to enter AP+STA mode");
+    return false;
+  }
 
-  // Set WiFi mode to AP+STA (needed for captive portal detection)
-  WiFi.mode(WIFI_AP_STA);
-  delay(100);
+  uint8_t channel = _config.AP_CHANNEL;
+  if (_config.AP_CHANNEL_FROM_SCAN) {
+    channel = strongestChannel(channel);
+  }
 
   // Configure AP IP settings
   if (!WiFi.softAPConfig(_apIP, _apIP, _netMask)) {
-    DEBUG_LOG("Failed to configure AP IP settings");
-    return;
+    WARN_LOG("Failed to configure AP IP settings");
+    return false;
   }
 
-  // Start Access Point
-  if (!WiFi.softAP(_apName)) {
-    DEBUG_LOG("Failed to start Access Point");
-    return;
+  // Start Access Point and wait for the driver's AP start event
+  if (!WiFi.softAP(_apName, nullptr, channel)) {
+    WARN_LOG("Failed to start Access Point");
+    return false;
+  }
+  if (!(WiFi.waitStatusBits(AP_STARTED_BIT, AP_START_TIMEOUT) & AP_STARTED_BIT)) {
+    WARN_LOG("Timed out waiting for the Access Point to start");
+    return false;
   }
 
-  DEBUG_LOG("Access Point '%s' started successfully", _apName);
+  DEBUG_LOG("Access Point '%s' started on channel %u", _apName, channel);
   DEBUG_LOG("AP IP address: %s", WiFi.softAPIP().toString().c_str());
+  return true;
+}
+
+uint8_t WiFiProvisioner::strongestChannel(uint8_t fallback) {
+  // Blocking, but it is also the portal's first scan: the results are left
+  // with the driver and picked up by the scan cache in startServers()
+  int count = WiFi.scanNetworks(false, false, _config.SCAN_PASSIVE, _config.SCAN_DWELL_MS);
+
+  uint8_t channel = fallback;
+  int8_t strongest = INT8_MIN;
+  for (int i = 0; i < count; i++) {
+    const wifi_ap_record_t* info = static_cast<const wifi_ap_record_t*>(WiFi.getScanInfoByIndex(i));
+    if (info && info->ssid[0] != '\0' && info->rssi > strongest) {
+      strongest = info->rssi;
+      channel = info->primary;
+    }
+  }
+  return channel;
 }
 
-void WiFiProvisioner::startServers() {
+bool WiFiProvisioner::startServers() {
   DEBUG_LOG("Starting web and DNS servers...");
 
-  // Initialize web server
-  _server = new WebServer(80);
-  _dnsServer = new DNSServer();
+  // What every session needs, whichever page it serves. Either all of it
+  // fits the budget and the heap, or the portal doesn't start.
+  const size_t required = sizeof(PortalServer) + sizeof(CaptiveDns) + sizeof(ScanCache) +
+                          2 * sizeof(HtmlTemplate);
+  if (!fitsBudget(required)) {
+    WARN_LOG("The portal needs %u bytes, more than the %u byte heap budget",
+             (unsigned)required, (unsigned)_heapBudget);
+    return false;
+  }
+  _server = new (std::nothrow) PortalServer(80);
+  _dnsServer = new (std::nothrow) CaptiveDns();
+  _template = new (std::nothrow) HtmlTemplate();
+  _gzipPage = new (std::nothrow) HtmlTemplate();
+  _scanCache = new (std::nothrow) ScanCache();
+  if (!_server || !_dnsServer || !_template || !_gzipPage || !_scanCache) {
+    WARN_LOG("Out of memory starting the portal");
+    return false;
+  }
+  trackAllocation(sizeof(PortalServer));
+  trackAllocation(sizeof(CaptiveDns));
+  trackAllocation(2 * sizeof(HtmlTemplate));
+  trackAllocation(sizeof(ScanCache));
 
   // Setup DNS server (captive portal)
-  _dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
-  _dnsServer->start(53, "*", _apIP);
+  if (!_dnsServer->start(53, _apIP)) {
+    WARN_LOG("Failed to start DNS server");
+  }
+
+  // Absolute portal URL for probe redirects, built once per session
+  snprintf(_portalUrl, sizeof(_portalUrl), "http://%u.%u.%u.%u/",
+           _apIP[0], _apIP[1], _apIP[2], _apIP[3]);
 
   // Setup web server routes
-  _server->on("/", [this]() { handleRootRequest(); });
-  _server->on("/connect", HTTP_POST, [this]() { handleConnectRequest(); });
-  _server->on("/favicon.ico", [this]() { _server->send(404, "text/plain", "Not found"); });
-
-  // Captive portal detection endpoints for different devices
-  _server->on("/generate_204", [this]() { handleRootRequest(); });          // Android
-  _server->on("/gen_204", [this]() { handleRootRequest(); });              // Android (short version)
-  _server->on("/fwlink", [this]() { handleRootRequest(); });               // Microsoft
-  _server->on("/hotspot-detect.html", [this]() { handleRootRequest(); });  // iOS
-  _server->on("/library/test/success.html", [this]() { handleRootRequest(); }); // iOS
-  _server->on("/ncsi.txt", [this]() { handleRootRequest(); });             // Windows
-  _server->on("/connecttest.txt", [this]() { handleRootRequest(); });      // Android
-  _server->on("/redirect", [this]() { handleRootRequest(); });             // Generic
+  _server->on("/", PortalServer::ANY, [this]() { handleRootRequest(); });
+  _server->on("/connect", PortalServer::POST, [this]() { handleConnectRequest(); });
+  _server->on("/configure", PortalServer::POST, [this]() { handleConfigureRequest(); }, MAX_CONFIGURE_BODY);
+  _server->on("/update", PortalServer::GET, [this]() { handleUpdateRequest(); });
+  _server->on("/networks", PortalServer::GET, [this]() { handleNetworksRequest(); });
+  _server->on("/networks.json", PortalServer::GET, [this]() { handleNetworksJsonRequest(); });
+  if (_config.ENABLE_METRICS) {
+    _server->on("/metrics", PortalServer::GET, [this]() { handleMetricsRequest(); });
+  }
+  _server->on("/favicon.ico", PortalServer::ANY, [this]() { _server->send(NOT_FOUND); });
+
+  // Captive portal detection endpoints for different devices. These only
+  // need to see something other than their expected answer, so they get a
+  // tiny redirect to the portal instead of the full page.
+  _server->on("/generate_204", PortalServer::ANY, [this]() { handleProbeRequest(); });          // Android
+  _server->on("/gen_204", PortalServer::ANY, [this]() { handleProbeRequest(); });              // Android (short version)
+  _server->on("/fwlink", PortalServer::ANY, [this]() { handleProbeRequest(); });               // Microsoft
+  _server->on("/hotspot-detect.html", PortalServer::ANY, [this]() { handleProbeRequest(); });  // iOS
+  _server->on("/library/test/success.html", PortalServer::ANY, [this]() { handleProbeRequest(); }); // iOS
+  _server->on("/ncsi.txt", PortalServer::ANY, [this]() { handleProbeRequest(); });             // Windows
+  _server->on("/connecttest.txt", PortalServer::ANY, [this]() { handleProbeRequest(); });      // Android
+  _server->on("/redirect", PortalServer::ANY, [this]() { handleProbeRequest(); });             // Generic
 
   _server->onNotFound([this]() {
-    DEBUG_LOG("Unknown request: %s %s", _server->method() == HTTP_GET ? "GET" : "POST", _server->uri().c_str());
-    handleRootRequest();
+    DEBUG_LOG("Unknown request: %s %s", _server->isPost() ? "POST" : "GET", _server->uri().c_str());
+    handleProbeRequest();
   });  // Catch-all
 
+  // Needed to pick the gzip or identity page per request
+  static const char* collectedHeaders[] = {"Accept-Encoding", "If-None-Match"};
+  _server->collectHeaders(collectedHeaders, 2);
+
   _server->begin();
   DEBUG_LOG("Servers started successfully");
 
-  // Start initial network scan in background (non-blocking)
+  // Wakes an idle pump as soon as a client associates
+  _stationEventId = WiFi.onEvent([this](arduino_event_id_t, arduino_event_info_t) { wakePump(); },
+                                 ARDUINO_EVENT_WIFI_AP_STACONNECTED);
+
+  // Load and pre-split the page template once for the whole portal session
+  uint32_t loadStart = micros();
+  if (_config.EMBEDDED_PAGE) {
+    attachEmbeddedPage();
+  } else if (!_config.USE_BUILTIN_PORTAL) {
+    loadHTMLTemplate();
+  }
+  _stats.templateLoadMicros = micros() - loadStart;
+  computeETags();
+
+  // Start initial network scan in background (non-blocking); handleClient()
+  // keeps the results fresh from here on
   DEBUG_LOG("Starting background network scan...");
-  WiFi.scanNetworks(true); // Async scan
+  _scanCache->setLimit(_config.SCAN_MAX_RESULTS);
+
+  if (_config.FANOUT_KEY) {
+    if (fitsBudget(sizeof(FanoutLink))) {
+      _fanout = new (std::nothrow) FanoutLink();
+    }
+    if (_fanout) {
+      trackAllocation(sizeof(FanoutLink));
+    }
+    if (!_fanout || !_fanout->begin(FanoutLink::RECEIVER, _config.FANOUT_KEY, true)) {
+      WARN_LOG("Failed to start fan-out receiver");
+      delete _fanout;
+      _fanout = nullptr;
+    }
+  }
+  _scanRefreshRequested = false;
+  updateScanCache();
+  return true;
 }
 
 void WiFiProvisioner::handleClient() {
+  sampleHeap();
   if (_dnsServer) {
-    _dnsServer->processNextRequest();
+    _stats.dnsQueries += _dnsServer->processPending();
   }
   if (_server) {
     _server->handleClient();
   }
+  if (_fanout) {
+    pollFanout();
+  }
+  updateVerification();
+  // Scans and the station's join attempt share the radio
+  uint8_t state = _verifyState;
+  if (_scanCache && state != VERIFY_REQUESTED && state != VERIFY_RUNNING) {
+    updateScanCache(_scanRefreshRequested.exchange(false));
+  }
+  publishStats();
 }
 
 void WiFiProvisioner::handleRootRequest() {
-  DEBUG_LOG("Handling root request from: %s", _server->client().remoteIP().toString().c_str());
+  DEBUG_LOG("Handling root request from: %s", _server->remoteIP().toString().c_str());
 
-  String html = loadHTMLTemplate();
-  if (html.length() == 0) {
-    _server->send(500, "text/plain", "Failed to load HTML template");
+  if (sendGzipPage()) {
+    DEBUG_LOG("Gzipped HTML page sent");
+    return;
+  }
+
+  if (sendNotModified(_pageETag)) {
+    DEBUG_LOG("HTML page not modified");
     return;
   }
 
   // Check if user explicitly requested a refresh via the refresh button
-  bool forceRefresh = _server->hasArg("refresh");
+  requestScanRefresh();
+  bool loading = !hasScanResults();
+
+  if (_pageETag[0] != '\0') {
+    _server->sendHeader("ETag", _pageETag);
+  }
+  _server->sendHeader("Cache-Control", "no-cache");
 
-  // Replace the networks placeholder with cached or fresh networks
-  String networksList = generateNetworksList(forceRefresh);
-  html.replace("{{NETWORKS_LIST}}", networksList);
+  if (!_template || !_template->isLoaded()) {
+    _server->stream(200, "text/html", [this](ResponseWriter& out) { writeBuiltinPortal(out); });
+    DEBUG_LOG("Built-in portal page sent");
+    return;
+  }
 
-  _server->send(200, "text/html", html);
+  // Stream the cached template segments, filling in each slot
+  _server->stream(200, "text/html", [this, loading](ResponseWriter& out) {
+    writeTemplate(out, loading);
+  });
   DEBUG_LOG("HTML page sent successfully");
 }
 
+void WiFiProvisioner::handleProbeRequest() {
+  // Fixed, uncacheable redirect; the OS then opens its captive sheet on "/"
+  _server->sendHeader("Location", _portalUrl);
+  _server->send(PROBE_REDIRECT);
+}
+
+void WiFiProvisioner::handleNetworksRequest() {
+  // Networks list fragment for static (e.g. gzipped) pages that can't use {{NETWORKS_LIST}}
+  requestScanRefresh();
+  bool loading = !hasScanResults();
+  _server->stream(200, "text/html", [this, loading](ResponseWriter& out) {
+    writeNetworksList(out, loading);
+  });
+}
+
+void WiFiProvisioner::handleNetworksJsonRequest() {
+  requestScanRefresh();
+  bool scanning = _scanRefreshRequested || WiFi.scanComplete() == WIFI_SCAN_RUNNING;
+  size_t count = hasScanResults() ? _scanCache->count() : 0;
+
+  // Previous results are served while a rescan runs; 202 tells the page a
+  // scan is still running and it should poll again
+  _server->stream(scanning ? 202 : 200, "application/json", [this, count](ResponseWriter& out) {
+    out.write("[", 1);
+
+    for (size_t i = 0; i < count; i++) {
+      const ScanRecord& network = (*_scanCache)[i];
+
+      char fields[48];
+      int length = snprintf(fields, sizeof(fields), "\",\"rssi\":%d,\"auth\":%u,\"ch\":%u}",
+                            network.rssi, network.authMode, network.channel);
+
+      out.write(i == 0 ? "{\"ssid\":\"" : ",{\"ssid\":\"");
+      writeJsonEscaped(out, network.ssid);
+      out.write(fields, length);
+    }
+
+    out.write("]", 1);
+  });
+}
+
+void WiFiProvisioner::handleMetricsRequest() {
+  // Copies, so every chunk of the async backend renders the same values;
+  // on that backend this also runs off the portal task
+  Stats stats = getStats();
+  HeapStats heap = getHeapStats();
+
+  _server->stream(200, "text/plain", [stats, heap](ResponseWriter& out) {
+    const struct { const char* name; uint32_t value; } metrics[] = {
+      {"template_load_us", stats.templateLoadMicros},
+      {"networks_list_us", stats.networksListMicros},
+      {"networks_list_max_us", stats.maxNetworksListMicros},
+      {"scans_completed", stats.scansCompleted},
+      {"last_scan_us", stats.lastScanMicros},
+      {"dns_queries", stats.dnsQueries},
+      {"http_requests", stats.httpRequests},
+      {"http_us", stats.httpMicros},
+      {"http_max_us", stats.maxHttpMicros},
+      {"heap_free_at_start", static_cast<uint32_t>(heap.freeAtStart)},
+      {"heap_min_free", static_cast<uint32_t>(heap.minFree)},
+      {"heap_min_largest_free_block", static_cast<uint32_t>(heap.minLargestFreeBlock)},
+      {"heap_largest_allocation", static_cast<uint32_t>(heap.largestAllocation)},
+      {"heap_allocated", static_cast<uint32_t>(heap.allocated)},
+    };
+
+    char line[64];
+    for (const auto& metric : metrics) {
+      int length = snprintf(line, sizeof(line), "wifiprov_%s %lu\n",
+                            metric.name, static_cast<unsigned long>(metric.value));
+      out.write(line, length);
+    }
+  });
+}
+
 void WiFiProvisioner::handleConnectRequest() {
   DEBUG_LOG("Handling connect request...");
 
   if (!_server->hasArg("ssid")) {
-    _server->send(400, "text/plain", "Missing SSID");
+    _server->send(MISSING_SSID);
     return;
   }
 
-  String ssid = _server->arg("ssid");
-  String password = _server->arg("password");
+  // Parsed straight into fixed buffers sized per 802.11
+  char ssid[33];
+  char password[65] = "";
+  if (!_server->copyArg("ssid", ssid, sizeof(ssid))) {
+    _server->send(SSID_TOO_LONG);
+    return;
+  }
+  if (_server->hasArg("password") && !_server->copyArg("password", password, sizeof(password))) {
+    _server->send(PASSWORD_TOO_LONG);
+    return;
+  }
 
   DEBUG_LOG("Received credentials - SSID: '%s', Password: '%s'",
-            ssid.c_str(), password.length() > 0 ? "[PROVIDED]" : "[EMPTY]");
+            ssid, password[0] ? "[PROVIDED]" : "[EMPTY]");
 
-  // Store credentials
+  if (!_config.VERIFY_CONNECTION) {
+    acceptCredentials(ssid, password);
+    secureWipe(password, sizeof(password));
+    _server->send(SUCCESS_PAGE);
+    DEBUG_LOG("Success page sent, credentials collection complete");
+    return;
+  }
+
+  bool requested = requestVerification(ssid, password);
+  secureWipe(password, sizeof(password));
+  if (!requested) {
+    _server->send(CONNECT_BUSY);
+    return;
+  }
+
+  // Lists the steps of the join as they happen and ends with the outcome;
+  // on failure the portal stays up so the form can be submitted again
+  _server->streamWhenReady(200, "text/html", [this]() { return verificationFinished(); },
+    [this](ResponseWriter& out) {
+      out.write_P(_verifyState == VERIFY_PASSED ? CONNECT_SUCCEEDED_TAIL : CONNECT_FAILED_TAIL);
+    },
+    [this](ResponseWriter& out) { writeVerifySteps(out, true); });
+}
+
+void WiFiProvisioner::handleConfigureRequest() {
+  DEBUG_LOG("Handling configure request...");
+
+  // The body and the document both hold the password, so both stay off
+  // String and are wiped before they are released
+  char body[MAX_CONFIGURE_BODY];
+  size_t length = _server->takeBody(body, sizeof(body));
+  if (length == 0) {
+    _server->send(CONFIGURE_BAD_PAYLOAD);
+    return;
+  }
+
+  WipingAllocator allocator;
+  JsonDocument doc(&allocator);
+  DeserializationError error = deserializeJson(doc, static_cast<const char*>(body), length);
+  secureWipe(body, length);
+  if (error) {
+    DEBUG_LOG("Invalid configure payload: %s", error.c_str());
+    _server->send(CONFIGURE_BAD_PAYLOAD);
+    return;
+  }
+
+  const char* ssid = doc["ssid"] | "";
+  if (strlen(ssid) == 0) {
+    _server->send(CONFIGURE_BAD_SSID);
+    return;
+  }
+
+  const char* password = doc["password"] | "";
+  if (strlen(ssid) > WiFiSsid::capacity() || strlen(password) > WiFiPassword::capacity()) {
+    _server->send(CONFIGURE_BAD_PAYLOAD);
+    return;
+  }
+
+  DEBUG_LOG("Received credentials - SSID: '%s', Password: '%s'",
+            ssid, strlen(password) > 0 ? "[PROVIDED]" : "[EMPTY]");
+
+  if (!_config.VERIFY_CONNECTION) {
+    acceptCredentials(ssid, password);
+    _server->send(CONFIGURE_OK);
+    DEBUG_LOG("Configure response sent, credentials collection complete");
+    return;
+  }
+
+  if (!requestVerification(ssid, password)) {
+    _server->send(CONFIGURE_BUSY);
+    return;
+  }
+
+  // The steps array grows while the join runs and the page shows the
+  // latest. It then shows "Invalid password" for reason "ssid" and a
+  // generic connection error otherwise, and lets the user try again.
+  _server->streamWhenReady(200, "application/json", [this]() { return verificationFinished(); },
+    [this](ResponseWriter& out) {
+      if (_verifyState == VERIFY_PASSED) {
+        out.write("],\"success\":true}");
+      } else {
+        out.write("],\"success\":false,\"reason\":\"");
+        out.write(_verifyReason);
+        out.write("\"}");
+      }
+    },
+    [this](ResponseWriter& out) { writeVerifySteps(out, false); });
+}
+
+void WiFiProvisioner::acceptCredentials(const char* ssid, const char* password) {
   _credentials.ssid = ssid;
   _credentials.password = password;
   _credentials.success = true;
   _credentials.error = "";
   _credentialsReceived = true;
+}
 
-  // Send success response
-  String successPage = R"(
-<!DOCTYPE html>
-<html>
-<head><title>Success</title></head>
-<body style="font-family: Arial; text-align: center; padding: 50px;">
-  <h1 style="color: green;">✓ Credentials Saved!</h1>
-  <p>WiFi credentials have been saved successfully.</p>
-  <p>The device will now attempt to connect...</p>
-</body>
-</html>)";
+bool WiFiProvisioner::requestVerification(const char* ssid, const char* password) {
+  uint8_t state = _verifyState;
+  if (state == VERIFY_REQUESTED || state == VERIFY_RUNNING || state == VERIFY_PASSED) {
+    return false;
+  }
 
-  _server->send(200, "text/html", successPage);
-  DEBUG_LOG("Success page sent, credentials collection complete");
+  // Only the pump touches the station; it picks this up in updateVerification()
+  _verifySsid = ssid;
+  _verifyPassword = password;
+  _verifyReason = "";
+  _verifyStep = VERIFY_STEP_NONE;
+  _verifyState = VERIFY_REQUESTED;
+  return true;
 }
 
-String WiFiProvisioner::loadHTMLTemplate() {
-  DEBUG_LOG("Loading HTML template from SPIFFS");
+bool WiFiProvisioner::verificationFinished() {
+#if !WIFI_PROV_ASYNC_SERVER
+  // The synchronous server is blocked in this handler, so keep the captive
+  // DNS answering and drive the attempt from here
+  _stats.dnsQueries += _dnsServer->processPending();
+  updateVerification();
+#endif
+  uint8_t state = _verifyState;
+  return state == VERIFY_PASSED || state == VERIFY_FAILED;
+}
 
-  if (!SPIFFS.begin(true)) {
-    DEBUG_LOG("Failed to mount SPIFFS, using fallback HTML");
-    return getFallbackHTML();
+void WiFiProvisioner::updateVerification() {
+  switch (_verifyState) {
+    case VERIFY_REQUESTED:
+      // Joining while a scan runs fails, so let the scan finish first
+      if (WiFi.scanComplete() == WIFI_SCAN_RUNNING) {
+        return;
+      }
+      DEBUG_LOG("Verifying credentials for '%s'...", _verifySsid.c_str());
+      // The AP follows the station's channel, so clients may briefly drop
+      WiFi.begin(_verifySsid.c_str(), _verifyPassword.c_str());
+      _verifyStartedAt = millis();
+      _verifyStep = VERIFY_STEP_CONNECTING;
+      _verifyState = VERIFY_RUNNING;
+      break;
+
+    case VERIFY_RUNNING: {
+      wl_status_t status = WiFi.status();
+      if (status == WL_CONNECTED) {
+        DEBUG_LOG("Credentials verified, connected to '%s'", _verifySsid.c_str());
+        _verifyAddress = WiFi.localIP();
+        _verifyStep = VERIFY_STEP_GOT_IP;
+        _verifyState = VERIFY_PASSED;
+        acceptCredentials(_verifySsid.c_str(), _verifyPassword.c_str());
+        _verifySsid.clear();
+        _verifyPassword.clear();
+      } else if (status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED ||
+                 millis() - _verifyStartedAt >= _config.CONNECT_TIMEOUT_MS) {
+        // A missing network, or one that took the password but gave no
+        // address, is reported as a network problem; anything else is most
+        // likely a wrong password
+        _verifyReason = (status == WL_NO_SSID_AVAIL || _verifyStep >= VERIFY_STEP_ASSOCIATED)
+                        ? "network" : "ssid";
+        WARN_LOG("Verification failed (status %d), portal stays up", status);
+        WiFi.disconnect();
+        _verifySsid.clear();
+        _verifyPassword.clear();
+        _verifyState = VERIFY_FAILED;
+      } else if (_verifyStep == VERIFY_STEP_CONNECTING) {
+        // The driver reports the AP only once the handshake has passed,
+        // i.e. the password was accepted; DHCP comes next
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+          _verifyStep = VERIFY_STEP_ASSOCIATED;
+        }
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void WiFiProvisioner::handleUpdateRequest() {
+  DEBUG_LOG("Handling network update request...");
+
+  // The built-in page fetches this once and expects a finished scan, so the
+  // answer waits for the first one, within SCAN_WAIT_TIMEOUT
+  unsigned long waitStart = millis();
+  _server->streamWhenReady(200, "application/json",
+                           [this, waitStart]() { return scanResultsReady(waitStart); },
+                           [this](ResponseWriter& out) {
+    // Nothing is published while this renders, so every chunk sees the same set
+    size_t count = _scanCache->isValid() ? _scanCache->count() : 0;
+    out.write("{\"show_code\":false,\"network\":[");
+
+    for (size_t i = 0; i < count; i++) {
+      const ScanRecord& network = (*_scanCache)[i];
+
+      char fields[48];
+      int length = snprintf(fields, sizeof(fields), "\",\"authmode\":%u,\"rssi\":%d}",
+                            network.authMode, getSignalLevel(network.rssi));
+
+      out.write(i == 0 ? "{\"ssid\":\"" : ",{\"ssid\":\"");
+      writeJsonEscaped(out, network.ssid);
+      out.write(fields, length);
+    }
+
+    out.write("]}");
+  });
+  DEBUG_LOG("Network update queued");
+}
+
+bool WiFiProvisioner::scanResultsReady(unsigned long waitStart) {
+#if !WIFI_PROV_ASYNC_SERVER
+  // The synchronous server is blocked in this handler, so keep the captive
+  // DNS answering and collect the scan from here. If no scan is running or
+  // can be started, there is nothing to wait for. A join in progress owns
+  // the radio and isn't driven from here, so don't wait on it either; like
+  // handleClient(), never start a scan under it.
+  _stats.dnsQueries += _dnsServer->processPending();
+  uint8_t state = _verifyState;
+  if (state == VERIFY_REQUESTED || state == VERIFY_RUNNING) {
+    return true;
+  }
+  if (!hasScanResults() && !updateScanCache()) {
+    return true;
   }
+#endif
+  return hasScanResults() || millis() - waitStart >= SCAN_WAIT_TIMEOUT;
+}
 
-  File file = SPIFFS.open("/wifiportal.html", "r");
-  if (!file) {
-    DEBUG_LOG("Failed to open /wifiportal.html from SPIFFS, using fallback HTML");
-    return getFallbackHTML();
+bool WiFiProvisioner::loadHTMLTemplate() {
+  DEBUG_LOG("Loading HTML template from " PORTAL_FS_NAME);
+
+  // Reuse a mount the application already did; totalBytes() is 0 otherwise.
+  // The pages are copied to RAM, so a mount of our own is undone right away.
+  bool mountedHere = PORTAL_FS.totalBytes() == 0;
+  if (mountedHere && !PORTAL_FS.begin(_config.FORMAT_FS_ON_FAIL)) {
+    WARN_LOG("Failed to mount " PORTAL_FS_NAME ", using built-in portal");
+    return false;
   }
 
-  String html = file.readString();
-  file.close();
+  // Pages that don't fit the heap budget are not loaded. Either one is
+  // served on its own: the gzipped page to clients that accept it, the
+  // template to the rest, with the built-in page standing in for a missing
+  // template. The template goes first since it serves every client.
+  bool loaded = _template->load(PORTAL_FS, "/wifiportal.html", true, remainingBudget());
+  if (loaded) {
+    trackAllocation(_template->length() + 1);
+    DEBUG_LOG("Successfully loaded HTML template (%d bytes, %d segments)",
+              _template->length(), _template->segmentCount());
+  }
+  if (_gzipPage->load(PORTAL_FS, "/wifiportal.html.gz", false, remainingBudget())) {
+    trackAllocation(_gzipPage->length() + 1);
+    DEBUG_LOG("Loaded gzipped page (%d bytes)", _gzipPage->length());
+  }
 
-  if (html.length() == 0) {
-    DEBUG_LOG("Empty HTML file, using fallback HTML");
-    return getFallbackHTML();
+  if (mountedHere) {
+    PORTAL_FS.end();
   }
 
-  DEBUG_LOG("Successfully loaded HTML template (%d bytes)", html.length());
-  return html;
+  if (!loaded) {
+    WARN_LOG("Failed to load /wifiportal.html from " PORTAL_FS_NAME
+             " or it exceeds the heap budget, using built-in portal%s",
+             _gzipPage->isLoaded() ? " for clients without gzip" : "");
+  }
+  return loaded;
 }
 
-String WiFiProvisioner::getFallbackHTML() {
-  return R"HTML(<!DOCTYPE html>
-<html>
-<head>
-    <title>WiFi Setup - File Missing</title>
-    <meta charset="UTF-8">
-    <meta name="viewport" content="width=device-width, initial-scale=1.0">
-    <style>
-        body {
-            font-family: Arial, sans-serif;
-            margin: 20px;
-            background: #f5f5f5;
-            text-align: center;
-        }
-        .container {
-            max-width: 500px;
-            margin: 50px auto;
-            background: white;
-            padding: 30px;
-            border-radius: 8px;
-            box-shadow: 0 2px 10px rgba(0,0,0,0.1);
-        }
-        h1 { color: #d32f2f; }
-        .info {
-            background: #fff3cd;
-            border: 1px solid #ffeaa7;
-            padding: 15px;
-            border-radius: 4px;
-            margin: 20px 0;
-            text-align: left;
-        }
-        code {
-            background: #f4f4f4;
-            padding: 2px 4px;
-            border-radius: 3px;
-            font-family: monospace;
-        }
-    </style>
-</head>
-<body>
-    <div class="container">
-        <h1>⚠️ Custom HTML Template Missing</h1>
-        <p>The WiFiProvisioner library is looking for a custom HTML template but couldn't find it.</p>
-
-        <div class="info">
-            <strong>Expected file location:</strong><br>
-            <code>/wifiportal.html</code> in your ESP32's SPIFFS filesystem
-
-            <br><br><strong>To fix this:</strong>
-            <ol>
-                <li>Create a <code>data/</code> folder in your project root</li>
-                <li>Copy the HTML template to <code>data/wifiportal.html</code></li>
-                <li>Add <code>board_build.filesystem = spiffs</code> to your platformio.ini</li>
-                <li>Run <code>pio run --target uploadfs</code> to upload the file</li>
-            </ol>
-        </div>
-
-        <p><strong>Basic Network Form:</strong></p>
-        <form action="/connect" method="POST" style="text-align: left;">
-            <label>Network Name (SSID):</label><br>
-            <input type="text" name="ssid" required style="width: 100%; padding: 8px; margin: 5px 0;"><br><br>
-
-            <label>Password:</label><br>
-            <input type="password" name="password" style="width: 100%; padding: 8px; margin: 5px 0;"><br><br>
-
-            <button type="submit" style="width: 100%; padding: 10px; background: #007cba; color: white; border: none; border-radius: 4px;">Connect</button>
-        </form>
-
-        <p style="font-size: 12px; color: #666; margin-top: 20px;">
-            Networks: {{NETWORKS_LIST}}
-        </p>
-    </div>
-</body>
-</html>)HTML";
-}
-
-String WiFiProvisioner::generateNetworksList(bool forceRefresh) {
-  unsigned long currentTime = millis();
-
-  // Check if we need to refresh the cache
-  bool needsRefresh = forceRefresh ||
-                     _cachedNetworksList.length() == 0 ||
-                     (currentTime - _lastScanTime > SCAN_INTERVAL);
-
-  if (!needsRefresh) {
-    DEBUG_LOG("Using cached networks list");
-    return _cachedNetworksList;
-  }
-
-  // Check if async scan is running
+bool WiFiProvisioner::attachEmbeddedPage() {
+  const EmbeddedPage& page = *_config.EMBEDDED_PAGE;
+
+  HtmlTemplate::Segment segments[HtmlTemplate::MAX_SEGMENTS];
+  if (page.segmentCount > HtmlTemplate::MAX_SEGMENTS) {
+    WARN_LOG("Embedded page has %u segments, more than WIFI_PROV_MAX_TEMPLATE_SEGMENTS",
+             (unsigned)page.segmentCount);
+    return false;
+  }
+  for (size_t i = 0; i < page.segmentCount; i++) {
+    // Checked before the cast, which would otherwise wrap it into range
+    if (page.segments[i][2] > HtmlTemplate::SLOT_LAST) {
+      WARN_LOG("Invalid embedded page, using built-in portal");
+      return false;
+    }
+    segments[i] = {page.segments[i][0], page.segments[i][1],
+                   static_cast<HtmlTemplate::Slot>(page.segments[i][2])};
+  }
+
+  if (!_template->attach(page.html, page.htmlLength, segments, page.segmentCount)) {
+    WARN_LOG("Invalid embedded page, using built-in portal");
+    return false;
+  }
+
+  if (page.gzip && page.gzipLength > 0) {
+    HtmlTemplate::Segment whole = {0, static_cast<uint32_t>(page.gzipLength), HtmlTemplate::SLOT_NONE};
+    _gzipPage->attach(reinterpret_cast<const char*>(page.gzip), page.gzipLength, &whole, 1);
+  }
+
+  DEBUG_LOG("Using embedded page (%u bytes, %u segments)",
+            (unsigned)page.htmlLength, (unsigned)page.segmentCount);
+  return true;
+}
+
+void WiFiProvisioner::writeTemplate(ResponseWriter& out, bool loading) {
+  for (size_t i = 0; i < _template->segmentCount(); i++) {
+    const HtmlTemplate::Segment& segment = _template->segment(i);
+    out.write(_template->data() + segment.offset, segment.length);
+    writeSlot(out, segment.slot, loading);
+  }
+}
+
+void WiFiProvisioner::writeSlot(ResponseWriter& out, uint8_t slot, bool loading) {
+  // Config values are trusted markup, the same as in the built-in page
+  switch (static_cast<HtmlTemplate::Slot>(slot)) {
+    case HtmlTemplate::SLOT_NETWORKS_LIST:         writeNetworksList(out, loading); break;
+    case HtmlTemplate::SLOT_HTML_TITLE:            out.write(_config.HTML_TITLE); break;
+    case HtmlTemplate::SLOT_THEME_COLOR:           out.write(_config.THEME_COLOR); break;
+    case HtmlTemplate::SLOT_SVG_LOGO:              out.write(_config.SVG_LOGO); break;
+    case HtmlTemplate::SLOT_PROJECT_TITLE:         out.write(_config.PROJECT_TITLE); break;
+    case HtmlTemplate::SLOT_PROJECT_SUB_TITLE:     out.write(_config.PROJECT_SUB_TITLE); break;
+    case HtmlTemplate::SLOT_PROJECT_INFO:          out.write(_config.PROJECT_INFO); break;
+    case HtmlTemplate::SLOT_FOOTER_TEXT:           out.write(_config.FOOTER_TEXT); break;
+    case HtmlTemplate::SLOT_CONNECTION_SUCCESSFUL: out.write(_config.CONNECTION_SUCCESSFUL); break;
+    case HtmlTemplate::SLOT_NONE:                  break;
+  }
+}
+
+void WiFiProvisioner::writeNetworksList(ResponseWriter& out, bool loading) {
+  if (loading) {
+    DEBUG_LOG("No scan results yet, showing loading indicator");
+    out.write_P(SCANNING_HTML);
+    return;
+  }
+
+  if (_scanCache->count() == 0) {
+    out.write("<div class=\"no-networks\">No networks found. Try refreshing.</div>");
+    return;
+  }
+
+  // Row fragments between the SSID and the signal label, indexed by isSecured
+  static const char* const SECURED_ATTR[] = {
+    "\" data-secured=\"false\"><span>", "\" data-secured=\"true\"><span>"
+  };
+  static const char* const NAME_END[] = {
+    "</span><span class=\"signal-strength\">", " 🔒</span><span class=\"signal-strength\">"
+  };
+
+  uint32_t start = micros();
+  for (size_t i = 0; i < _scanCache->count(); i++) {
+    const ScanRecord& network = (*_scanCache)[i];
+    int isSecured = (network.authMode != WIFI_AUTH_OPEN) ? 1 : 0;
+
+    // SSIDs are chosen by whoever runs the access point, so never send them raw
+    out.write("<div class=\"network\" data-ssid=\"");
+    writeHtmlEscaped(out, network.ssid);
+    out.write(SECURED_ATTR[isSecured]);
+    writeHtmlEscaped(out, network.ssid);
+    out.write(NAME_END[isSecured]);
+    out.write(getSignalStrength(network.rssi));
+    out.write("</span></div>");
+  }
+
+  _stats.networksListMicros = micros() - start;
+  if (_stats.networksListMicros > _stats.maxNetworksListMicros) {
+    _stats.maxNetworksListMicros = _stats.networksListMicros;
+  }
+}
+
+bool WiFiProvisioner::updateScanCache(bool forceRefresh) {
+  // A finished scan is swapped in only while no handler runs and no
+  // streamed response is open; until then the previous one is served
+  if (_scanStaged) {
+    if (!_server->runExclusive([this]() { _scanCache->publish(); })) {
+      return false;
+    }
+    _scanStaged = false;
+  }
+
   int scanResult = WiFi.scanComplete();
 
   if (scanResult == WIFI_SCAN_RUNNING) {
-    DEBUG_LOG("Scan in progress, showing loading indicator");
-    return "<div class=\"scanning\">📶 Scanning for networks... <div class=\"spinner\"></div></div>";
+    return true;
+  }
+
+  // Copy finished results out of the driver once; scanDelete() frees them.
+  // Every pass goes to the staging set, which is published after the last.
+  if (scanResult >= 0) {
+    DEBUG_LOG("Processing scan results: %d networks found", scanResult);
+    _scanCache->stage(scanResult, _scanPass == 0);
+
+    // Targeted scans run as several short passes back to back
+    if (++_scanPass < scanPassCount()) {
+      if (startScan(_scanPass)) {
+        return true;
+      }
+      // Publish what the passes so far found rather than nothing
+      WARN_LOG("Scan pass %u of %u failed to start", (unsigned)_scanPass + 1, (unsigned)scanPassCount());
+    } else {
+      _stats.scansCompleted++;
+      if (_scanStartedAt) {
+        _stats.lastScanMicros = micros() - _scanStartedAt;
+      }
+    }
+    _scanStartedAt = 0;
+    _scanPass = 0;
+
+    _scanStaged = !_server->runExclusive([this]() { _scanCache->publish(); });
+    if (_scanStaged) {
+      return false;
+    }
   }
 
-  // If no scan running and we need refresh, start async scan
-  if (scanResult == WIFI_SCAN_FAILED || forceRefresh) {
+  // Rescan once the results reach SCAN_INTERVAL_MS, ahead of SCAN_MAX_AGE_MS,
+  // so the previous results stay on screen while the new scan runs
+  bool due = !_scanCache->isValid() ||
+             (millis() - _scanCache->updatedAt() >= _config.SCAN_INTERVAL_MS);
+
+  if (forceRefresh || due) {
     DEBUG_LOG("Starting async network scan (refresh=%s)...", forceRefresh ? "forced" : "auto");
-    WiFi.scanNetworks(true); // Start async scan
-    return "<div class=\"scanning\">📶 Scanning for networks... <div class=\"spinner\"></div></div>";
+    _scanPass = 0;
+    _scanStartedAt = micros() | 1;
+    if (startScan(_scanPass)) {
+      return true;
+    }
+    // Retried on the next call, as the results are still due
+    DEBUG_LOG("Failed to start network scan");
+    _scanStartedAt = 0;
+  }
+
+  return false;
+}
+
+size_t WiFiProvisioner::scanPassCount() const {
+  size_t channels = (_config.SCAN_CHANNELS && _config.SCAN_CHANNEL_COUNT) ? _config.SCAN_CHANNEL_COUNT : 1;
+  size_t ssids = (_config.SCAN_SSIDS && _config.SCAN_SSID_COUNT) ? _config.SCAN_SSID_COUNT : 1;
+  return channels * ssids;
+}
+
+bool WiFiProvisioner::startScan(size_t pass) {
+  // Channel 0 and a null SSID leave the driver's full scan in place
+  uint8_t channel = 0;
+  const char* ssid = nullptr;
+
+  if (_config.SCAN_CHANNELS && _config.SCAN_CHANNEL_COUNT) {
+    channel = _config.SCAN_CHANNELS[pass % _config.SCAN_CHANNEL_COUNT];
+    pass /= _config.SCAN_CHANNEL_COUNT;
+  }
+  if (_config.SCAN_SSIDS && _config.SCAN_SSID_COUNT) {
+    ssid = _config.SCAN_SSIDS[pass];
+  }
+
+  return WiFi.scanNetworks(true, false, _config.SCAN_PASSIVE, _config.SCAN_DWELL_MS, channel, ssid) == WIFI_SCAN_RUNNING;
+}
+
+bool WiFiProvisioner::hasScanResults() {
+  return _scanCache->isValid() &&
+         (millis() - _scanCache->updatedAt() < _config.SCAN_MAX_AGE_MS);
+}
+
+void WiFiProvisioner::requestScanRefresh() {
+  // Scans are started from handleClient(), never from inside a handler
+  if (_server->hasArg("refresh")) {
+    _scanRefreshRequested = true;
   }
+}
 
-  // Process completed scan results
-  int networkCount = scanResult;
-  DEBUG_LOG("Processing scan results: %d networks found", networkCount);
+bool WiFiProvisioner::sendGzipPage() {
+  const char* data = nullptr;
+  size_t length = 0;
+
+  if (_gzipPage && _gzipPage->isLoaded()) {
+    data = _gzipPage->data();
+    length = _gzipPage->length();
+  } else if (_config.GZIP_PAGE && _config.GZIP_PAGE_LENGTH > 0) {
+    data = reinterpret_cast<const char*>(_config.GZIP_PAGE);
+    length = _config.GZIP_PAGE_LENGTH;
+  } else {
+    return false;
+  }
 
-  if (networkCount == 0) {
-    _cachedNetworksList = "<div class=\"no-networks\">No networks found. Try refreshing.</div>";
-    _lastScanTime = currentTime;
-    return _cachedNetworksList;
+  _server->sendHeader("Vary", "Accept-Encoding");
+  if (_server->header("Accept-Encoding").indexOf("gzip") < 0) {
+    return false;
   }
 
-  String networksList = "";
+  if (sendNotModified(_gzipETag)) {
+    return true;
+  }
 
-  for (int i = 0; i < networkCount; i++) {
-    String ssid = WiFi.SSID(i);
-    int32_t rssi = WiFi.RSSI(i);
-    bool isSecured = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+  _server->sendHeader("Content-Encoding", "gzip");
+  _server->sendHeader("ETag", _gzipETag);
+  _server->sendHeader("Cache-Control", "no-cache");
+  _server->send_P(200, "text/html", data, length);
+  return true;
+}
 
-    if (ssid.length() == 0) continue;  // Skip hidden networks
+bool WiFiProvisioner::sendNotModified(const char* etag) {
+  if (etag[0] == '\0' || _server->header("If-None-Match").indexOf(etag) < 0) {
+    return false;
+  }
 
-    String signalStrength = getSignalStrength(rssi);
-    String lockIcon = isSecured ? " 🔒" : "";
+  _server->sendHeader("ETag", etag);
+  _server->send(NOT_MODIFIED);
+  return true;
+}
 
-    networksList += "<div class=\"network\" data-ssid=\"" + ssid + "\" data-secured=\"" +
-                   (isSecured ? "true" : "false") + "\">";
-    networksList += "<span>" + ssid + lockIcon + "</span>";
-    networksList += "<span class=\"signal-strength\">" + signalStrength + "</span>";
-    networksList += "</div>";
+void WiFiProvisioner::computeETags() {
+  // Only pages without per-request content get an ETag; a template with
+  // {{NETWORKS_LIST}} slots changes with every scan, while Config slots are
+  // fixed for the session and digested as rendered. Embedded pages may
+  // carry ETags computed when they were generated.
+  _pageETag[0] = '\0';
+  _gzipETag[0] = '\0';
+
+  const EmbeddedPage* embedded = _template->isLoaded() ? _config.EMBEDDED_PAGE : nullptr;
+  bool staticTemplate = _template->isLoaded() && !_template->hasSlot(HtmlTemplate::SLOT_NETWORKS_LIST);
+
+  if (embedded && embedded->etag) {
+    strlcpy(_pageETag, embedded->etag, sizeof(_pageETag));
+  } else if (!_template->isLoaded() || staticTemplate) {
+    DigestResponseWriter digest;
+    if (staticTemplate) {
+      writeTemplate(digest, false);
+    } else {
+      writeBuiltinPortal(digest);
+    }
+    snprintf(_pageETag, sizeof(_pageETag), "\"%08x\"", static_cast<unsigned>(digest.digest()));
+  }
 
-    DEBUG_LOG("Network %d: %s (%s, %s)", i, ssid.c_str(),
-              signalStrength.c_str(), isSecured ? "Secured" : "Open");
+  if (embedded && embedded->gzipETag && _gzipPage->isLoaded()) {
+    strlcpy(_gzipETag, embedded->gzipETag, sizeof(_gzipETag));
+    return;
   }
 
-  // Cache the results and clear scan results
-  _cachedNetworksList = networksList;
-  _lastScanTime = currentTime;
-  WiFi.scanDelete(); // Free memory
+  DigestResponseWriter gzipDigest;
+  if (_gzipPage->isLoaded()) {
+    gzipDigest.write(_gzipPage->data(), _gzipPage->length());
+  } else if (_config.GZIP_PAGE && _config.GZIP_PAGE_LENGTH > 0) {
+    gzipDigest.write_P(reinterpret_cast<const char*>(_config.GZIP_PAGE), _config.GZIP_PAGE_LENGTH);
+  }
+  if (gzipDigest.bytesWritten() > 0) {
+    snprintf(_gzipETag, sizeof(_gzipETag), "\"%08x\"", static_cast<unsigned>(gzipDigest.digest()));
+  }
+}
+
+void WiFiProvisioner::writeBuiltinPortal(ResponseWriter& out) {
+  // Flash-resident fragments, interleaved with the configured slot values
+  out.write_P(index_html1);
+  out.write(_config.HTML_TITLE);
+  out.write_P(index_html2);
+  out.write(_config.THEME_COLOR);
+  out.write_P(index_html3);
+  out.write(_config.SVG_LOGO);
+  out.write_P(index_html4);
+  out.write(_config.PROJECT_TITLE);
+  out.write_P(index_html5);
+  out.write(_config.PROJECT_SUB_TITLE);
+  out.write_P(index_html6);
+  out.write(_config.PROJECT_INFO);
+  out.write_P(index_html7);
+  out.write("");   // INPUT_NAME, the extra input field is not supported
+  out.write_P(index_html8);
+  out.write("0");  // INPUT_LENGTH
+  out.write_P(index_html9);
+  out.write(_config.CONNECTION_SUCCESSFUL);
+  out.write_P(index_html10);
+  out.write(_config.FOOTER_TEXT);
+  out.write_P(index_html11);
+  out.write("");   // RESET_CONFIRMATION_TEXT, factory reset is not supported
+  out.write_P(index_html12);
+  out.write("false");  // RESET_SHOW
+  out.write_P(index_html13);
+}
 
-  DEBUG_LOG("Generated and cached networks list with %d networks", networkCount);
-  return networksList;
+void WiFiProvisioner::writeJsonEscaped(ResponseWriter& out, const char* text) {
+  const char* run = text;
+  for (const char* p = text; *p; p++) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c != '"' && c != '\\' && c >= 0x20) continue;
+
+    out.write(run, p - run);
+    if (c == '"' || c == '\\') {
+      char escaped[2] = {'\\', static_cast<char>(c)};
+      out.write(escaped, sizeof(escaped));
+    } else {
+      char escaped[7];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out.write(escaped, 6);
+    }
+    run = p + 1;
+  }
+  out.write(run);
 }
 
-String WiFiProvisioner::getSignalStrength(int rssi) {
-  if (rssi > -50) return "Excellent";
-  if (rssi > -60) return "Good";
-  if (rssi > -70) return "Fair";
-  return "Weak";
+void WiFiProvisioner::writeHtmlEscaped(ResponseWriter& out, const char* text) {
+  // Safe in both element text and double- or single-quoted attributes
+  const char* run = text;
+  for (const char* p = text; *p; p++) {
+    const char* entity;
+    switch (*p) {
+      case '&':  entity = "&amp;"; break;
+      case '<':  entity = "&lt;"; break;
+      case '>':  entity = "&gt;"; break;
+      case '"':  entity = "&quot;"; break;
+      case '\'': entity = "&#39;"; break;
+      default:   continue;
+    }
+    out.write(run, p - run);
+    out.write(entity);
+    run = p + 1;
+  }
+  out.write(run);
+}
+
+void WiFiProvisioner::writeVerifySteps(ResponseWriter& out, bool html) {
+  // Rendered again on every poll while the join runs. Steps are only ever
+  // added, so the output only grows, as streamWhenReady() requires.
+  uint8_t step = _verifyStep;
+  if (!html) {
+    // /configure opens its JSON answer with the steps reached so far
+    static const char* const NAMES[] = {"\"connecting\"", ",\"associated\"", ",\"got_ip\""};
+    out.write("{\"steps\":[");
+    for (uint8_t i = VERIFY_STEP_CONNECTING; i <= step; i++) {
+      out.write(NAMES[i - VERIFY_STEP_CONNECTING]);
+    }
+    return;
+  }
+
+  out.write_P(CONNECT_PROGRESS_HEAD);
+  if (step >= VERIFY_STEP_CONNECTING) {
+    out.write_P(CONNECT_STEP_CONNECTING);
+  }
+  if (step >= VERIFY_STEP_ASSOCIATED) {
+    out.write_P(CONNECT_STEP_ASSOCIATED);
+  }
+  if (step >= VERIFY_STEP_GOT_IP) {
+    char line[48];
+    int length = snprintf(line, sizeof(line), "  <p>Got IP address %u.%u.%u.%u</p>\n",
+                          _verifyAddress[0], _verifyAddress[1], _verifyAddress[2], _verifyAddress[3]);
+    out.write(line, length);
+  }
+}
+
+int WiFiProvisioner::getSignalLevel(int rssi) {
+  if (rssi > -50) return 4;
+  if (rssi > -60) return 3;
+  if (rssi > -70) return 2;
+  return 1;
+}
+
+const char* WiFiProvisioner::getSignalStrength(int rssi) {
+  static const char* const LABELS[] = {"Weak", "Fair", "Good", "Excellent"};
+  return LABELS[getSignalLevel(rssi) - 1];
 }
 
 void WiFiProvisioner::releaseResources() {
   DEBUG_LOG("Releasing resources...");
+  // Open async responses may outlast ASYNC_RESPONSE_TIMEOUT; make sure none
+  // of them renders from what is freed below
+  if (_server) {
+    _server->cancelStreams();
+  }
+  sampleHeap();
+  DEBUG_LOG("Session heap: %u free at start, %u min free, %u min largest block, %u allocated, largest %u",
+            (unsigned)_heapStats.freeAtStart, (unsigned)_heapStats.minFree,
+            (unsigned)_heapStats.minLargestFreeBlock,
+            (unsigned)_heapStats.allocated, (unsigned)_heapStats.largestAllocation);
+  // The server's counters go with it
+  publishStats();
+
+  if (_stationEventId) {
+    WiFi.removeEvent(_stationEventId);
+    _stationEventId = 0;
+  }
+  _pumpTask = nullptr;
 
   if (_server) {
     _server->stop();
@@ -374,6 +1598,27 @@ void WiFiProvisioner::releaseResources() {
     _dnsServer = nullptr;
   }
 
+  if (_fanout) {
+    _fanout->end();
+    delete _fanout;
+    _fanout = nullptr;
+  }
+
+  if (_template) {
+    delete _template;
+    _template = nullptr;
+  }
+
+  if (_gzipPage) {
+    delete _gzipPage;
+    _gzipPage = nullptr;
+  }
+
+  if (_scanCache) {
+    delete _scanCache;
+    _scanCache = nullptr;
+  }
+
   // Stop AP mode
   WiFi.softAPdisconnect(true);
   WiFi.mode(WIFI_STA);
@@ -2,55 +2,424 @@
 #define WIFIPROVISIONER_H
 
 #include <IPAddress.h>
+#include <atomic>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 
-class WebServer;
-class DNSServer;
+class PortalServer;
+class CaptiveDns;
+class HtmlTemplate;
+class ResponseWriter;
+class ScanCache;
+class CredentialStore;
+class FanoutLink;
+struct StoredNetwork;
+
+// Fixed-size, NUL-terminated credential field. It lives inline wherever it
+// is declared rather than on the heap, and is wiped when cleared or
+// destroyed, so no copy of a secret lingers in freed memory. Longer input
+// is cut to N - 1 characters.
+template <size_t N>
+class CredentialString {
+public:
+  CredentialString() { _data[0] = '\0'; }
+  CredentialString(const char* value) { assign(value); }
+  CredentialString(const CredentialString& other) { assign(other._data); }
+  ~CredentialString() { wipe(); }
+
+  CredentialString& operator=(const char* value) { assign(value); return *this; }
+  CredentialString& operator=(const CredentialString& other) {
+    if (this != &other) assign(other._data);
+    return *this;
+  }
+
+  void assign(const char* value) {
+    size_t length = value ? strlen(value) : 0;
+    assign(value, length < N ? length : N - 1);
+  }
+  void assign(const char* value, size_t length) {
+    wipe();
+    if (!value || length == 0) {
+      return;
+    }
+    if (length >= N) {
+      length = N - 1;
+    }
+    memcpy(_data, value, length);
+    _data[length] = '\0';
+  }
+  void clear() { wipe(); }
+
+  const char* c_str() const { return _data; }
+  operator const char*() const { return _data; }
+
+  // By contents; through the const char* conversion == would compare
+  // addresses. nullptr equals an empty string.
+  bool operator==(const char* other) const { return strcmp(_data, other ? other : "") == 0; }
+  bool operator==(const String& other) const { return strcmp(_data, other.c_str()) == 0; }
+  template <size_t M>
+  bool operator==(const CredentialString<M>& other) const { return strcmp(_data, other.c_str()) == 0; }
+  bool operator!=(const char* other) const { return !(*this == other); }
+  bool operator!=(const String& other) const { return !(*this == other); }
+  template <size_t M>
+  bool operator!=(const CredentialString<M>& other) const { return !(*this == other); }
+  friend bool operator==(const char* lhs, const CredentialString& rhs) { return rhs == lhs; }
+  friend bool operator==(const String& lhs, const CredentialString& rhs) { return rhs == lhs; }
+  friend bool operator!=(const char* lhs, const CredentialString& rhs) { return rhs != lhs; }
+  friend bool operator!=(const String& lhs, const CredentialString& rhs) { return rhs != lhs; }
+  size_t length() const { return strlen(_data); }
+  bool isEmpty() const { return _data[0] == '\0'; }
+  static size_t capacity() { return N - 1; }
+
+private:
+  void wipe() {
+    // volatile keeps the compiler from dropping stores to a dying object
+    volatile char* p = _data;
+    for (size_t i = 0; i < N; i++) p[i] = '\0';
+  }
+
+  char _data[N];
+};
+
+// SSIDs are at most 32 bytes and WPA2 passphrases at most 64 (802.11)
+typedef CredentialString<33> WiFiSsid;
+typedef CredentialString<65> WiFiPassword;
 
 struct WiFiCredentials {
-  String ssid;
-  String password;
+  WiFiSsid ssid;
+  WiFiPassword password;
   bool success;
   String error;
 };
 
+// Portal page compiled into flash by extras/embed_template.py, so it needs
+// neither a filesystem upload nor a parse at startup
+struct EmbeddedPage {
+  const char* html;
+  size_t htmlLength;
+  const uint32_t (*segments)[3];  // Literal offset, length and following slot
+  size_t segmentCount;
+  const char* etag;               // nullptr when the page has placeholders
+  const uint8_t* gzip;            // Optional pre-gzipped copy
+  size_t gzipLength;
+  const char* gzipETag;
+};
+
 class WiFiProvisioner {
 public:
+  // Values filled into the built-in portal page (src/internal/provision_html.h).
+  // They are served as-is, so they must not contain backticks.
+  struct Config {
+    const char* HTML_TITLE = "Welcome to Wi-Fi Provision";
+    const char* THEME_COLOR = "dodgerblue";
+    const char* SVG_LOGO =
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"64\" height=\"64\" viewBox=\"0 0 24 24\">"
+      "<path fill=\"var(--theme-color)\" d=\"M12 21l3.6-4.8A6 6 0 0 0 12 15a6 6 0 0 0-3.6 1.2zm0-18"
+      "C7.95 3 4.21 4.34 1.2 6.6l1.8 2.4C5.5 7.12 8.62 6 12 6s6.5 1.12 9 3l1.8-2.4C19.79 4.34 16.05 3 12 3"
+      "m0 6c-2.7 0-5.19.89-7.2 2.4l1.8 2.4C8.1 12.67 9.97 12 12 12s3.9.67 5.4 1.8l1.8-2.4C17.19 9.89 14.7 9 12 9\"/></svg>";
+    const char* PROJECT_TITLE = "WiFi Provisioner";
+    const char* PROJECT_SUB_TITLE = "Device Setup";
+    const char* PROJECT_INFO = "Follow the steps to provision your device";
+    const char* FOOTER_TEXT = "All rights reserved © WiFiProvisioner";
+    const char* CONNECTION_SUCCESSFUL = "Your device is now provisioned and ready to use.";
+
+    // Channel the AP runs on. With AP_CHANNEL_FROM_SCAN the first scan runs
+    // before the AP starts, adding its duration to begin(), and the AP uses
+    // the strongest network's channel instead. Joining that network then
+    // doesn't move the AP, and AP_STA scans stall clients less.
+    uint8_t AP_CHANNEL = 1;
+    bool AP_CHANNEL_FROM_SCAN = false;
+
+    // Background scanning: results are refreshed every SCAN_INTERVAL_MS while
+    // the portal runs, and the previous results keep being served until they
+    // are SCAN_MAX_AGE_MS old. SCAN_DWELL_MS is the time spent per channel.
+    unsigned long SCAN_INTERVAL_MS = 30000;
+    unsigned long SCAN_MAX_AGE_MS = 90000;
+    bool SCAN_PASSIVE = false;
+    uint32_t SCAN_DWELL_MS = 300;
+
+    // Optional targeted scans. When SCAN_CHANNELS is set only those channels
+    // are visited, and when SCAN_SSIDS is set only those networks are probed.
+    // Each channel/SSID pair is one short scan and the passes are merged, so
+    // a site with a known channel plan can pair these with a lower
+    // SCAN_DWELL_MS (e.g. 100) to refresh without stalling the portal.
+    const uint8_t* SCAN_CHANNELS = nullptr;
+    size_t SCAN_CHANNEL_COUNT = 0;
+    const char* const* SCAN_SSIDS = nullptr;
+    size_t SCAN_SSID_COUNT = 0;
+
+    // Most networks listed, strongest first and one per SSID. Capped at
+    // WIFI_PROV_MAX_NETWORKS; 0 keeps that cap.
+    size_t SCAN_MAX_RESULTS = 0;
+
+    // connectOrProvision(): NVS namespace the last working network is kept
+    // in, and how long each association attempt may take
+    const char* STORAGE_NAMESPACE = "wifiprov";
+    unsigned long CONNECT_TIMEOUT_MS = 10000;
+
+    // Join the submitted network while the AP stays up, and only finish
+    // provisioning once that worked. /configure and /connect answer with
+    // the outcome, so a wrong password can be corrected on the spot.
+    bool VERIFY_CONNECTION = true;
+
+    // While no client is associated with the AP, getCredentials() and the
+    // portal task wake only this often, or as soon as a station joins,
+    // instead of every tick. With one associated they sleep on the DNS
+    // socket for at most 10 ms at a time. 0 polls every tick regardless.
+    unsigned long IDLE_POLL_MS = 250;
+
+    // Closes the portal after this long without credentials; the result,
+    // and in loop() and task mode the onCredentials() callback, then has
+    // success == false and error set. 0 waits forever.
+    unsigned long PORTAL_TIMEOUT_MS = 0;
+
+    // Serve the built-in page without mounting the filesystem or looking for /wifiportal.html
+    bool USE_BUILTIN_PORTAL = false;
+    // Shared secret for fan-out provisioning. When set, the portal also
+    // accepts credentials pushed over ESP-NOW by a device running
+    // shareCredentials() with the same key. The AP must then be on that
+    // device's channel, e.g. with AP_CHANNEL_FROM_SCAN.
+    const char* FANOUT_KEY = nullptr;
+
+    // Page generated by extras/embed_template.py; takes precedence over the
+    // filesystem and the built-in page
+    const EmbeddedPage* EMBEDDED_PAGE = nullptr;
+
+    // Upper bound in bytes for the portal's own objects and the pages it
+    // loads into RAM, 0 for none; lowered to the free heap if less is free
+    // at begin(). begin() fails when the servers and scan cache don't fit,
+    // pages that don't fit are skipped in favour of the built-in portal and
+    // the fan-out receiver is left out. Buffers the web server, lwIP and
+    // ESP-NOW allocate per request are not counted; /configure bodies are
+    // capped separately. getHeapStats() reports what the heap went through.
+    size_t HEAP_BUDGET = 0;
+
+    // Serve getStats() and getHeapStats() as plain text on /metrics
+    bool ENABLE_METRICS = false;
+
+    // Format the filesystem when it fails to mount. This can block for
+    // several seconds and erases whatever the partition held.
+    bool FORMAT_FS_ON_FAIL = false;
+
+    // Optional pre-gzipped page in flash, sent to clients that accept gzip
+    // when the filesystem has no /wifiportal.html.gz. Compressed pages cannot hold
+    // {{NETWORKS_LIST}}; they should fetch the rows from /networks instead.
+    const uint8_t* GZIP_PAGE = nullptr;
+    size_t GZIP_PAGE_LENGTH = 0;
+  };
+
+  // Heap use of the current or last portal session
+  struct HeapStats {
+    size_t freeAtStart;         // Free heap when begin() was called
+    size_t minFree;             // Lowest free heap while running, including dips between samples
+    size_t minLargestFreeBlock; // Lowest sampled largest free block, i.e. the biggest allocation sure to succeed
+    size_t largestAllocation;   // Largest buffer counted against HEAP_BUDGET
+    size_t allocated;           // Bytes counted against HEAP_BUDGET
+  };
+
+  // Timings (microseconds) and counters of the current or last session
+  struct Stats {
+    uint32_t templateLoadMicros;     // loadHTMLTemplate()
+    uint32_t networksListMicros;     // Last networks list render
+    uint32_t maxNetworksListMicros;
+    uint32_t scansCompleted;
+    uint32_t lastScanMicros;         // From starting a scan to caching its results
+    uint32_t dnsQueries;             // DNS queries answered
+    uint32_t httpRequests;
+    uint32_t httpMicros;             // Total time spent in HTTP handlers
+    uint32_t maxHttpMicros;
+  };
+
+  typedef std::function<void(const WiFiCredentials&)> CredentialsCallback;
+
   explicit WiFiProvisioner(const char* apName = "ESP32 Wi-Fi Setup");
   ~WiFiProvisioner();
 
-  // Blocking function that returns credentials or error
+  // Blocking function that returns credentials or error. The onCredentials()
+  // callback is for the non-blocking modes and is not invoked here.
   WiFiCredentials getCredentials();
 
+  // Connects to the network saved by a previous call, pinned to its BSSID
+  // and channel so the driver can skip scanning. Only when that fails is
+  // the portal brought up; the new network is connected to and saved.
+  // Leaves the station connected when success is true.
+  WiFiCredentials connectOrProvision();
+  void forgetCredentials();
+
+  // Fan-out: hands these credentials to nearby portals that share
+  // Config::FANOUT_KEY, for durationMs. Call once connected to the network,
+  // since ESP-NOW uses the current channel. Returns the devices served.
+  size_t shareCredentials(const WiFiCredentials& credentials, unsigned long durationMs);
+
+  // Non-blocking alternative: begin() brings the portal up and loop() must
+  // then be called as often as possible. When credentials arrive, or
+  // Config::PORTAL_TIMEOUT_MS runs out, the portal is shut down and the
+  // onCredentials() callback is invoked; check success before using them.
+  bool begin();
+  void loop();
+  void end();
+  bool isRunning() const { return _running && !_taskExited; }
+  void onCredentials(CredentialsCallback callback);
+  // Why the last session ended without credentials, e.g. begin() failing
+  // or the portal timing out; empty otherwise
+  const String& lastError() const { return _credentials.error; }
+
+  // Runs begin() and then pumps the portal from its own FreeRTOS task, e.g.
+  // on core 0 next to the WiFi stack. loop() must not be called in this
+  // mode, and the onCredentials() callback runs on the portal task.
+  // A core of -1 leaves the task unpinned.
+  bool beginTask(uint32_t stackSize = 6144, UBaseType_t priority = 1, BaseType_t core = 0);
+  // Blocks the calling task until the portal task has delivered credentials,
+  // or returns false on timeout or when the portal stopped without them.
+  // Once the task has stopped, credentials carries the error, if any.
+  bool waitForCredentials(WiFiCredentials& credentials, TickType_t timeout = portMAX_DELAY);
+
+  // Copies taken by the task pumping the portal after each pass, so they
+  // can be read from any task
+  HeapStats getHeapStats() const;
+  Stats getStats() const;
+
+  // Must be modified before getCredentials() is called
+  Config& getConfig() { return _config; }
+
 private:
-  void setupAP();
-  void startServers();
+  static void portalTask(void* arg);
+  bool credentialsComplete();
+  bool scanResultsReady(unsigned long waitStart);
+  bool pollPortal();
+  bool checkPortalTimeout();
+  bool portalIdle();
+  uint32_t waitForWork();
+  void wakePump();
+  void collectPortalTask();
+  bool reapPortalTask();
+
+  bool connectStation(const char* ssid, const char* password, int32_t channel, const uint8_t* bssid);
+  void rememberNetwork(CredentialStore& store, const StoredNetwork* previous,
+                       const char* ssid, const char* password);
+
+  void acceptCredentials(const char* ssid, const char* password);
+  // Hands _credentials to the caller and wipes the provisioner's copy
+  void takeCredentials(WiFiCredentials& credentials);
+  bool requestVerification(const char* ssid, const char* password);
+  bool verificationFinished();
+  void updateVerification();
+  void pollFanout();
+
+  void trackAllocation(size_t bytes);
+  size_t remainingBudget() const;
+  bool fitsBudget(size_t bytes) const;
+  void sampleHeap();
+  void publishStats();
+
+  bool setupAP();
+  uint8_t strongestChannel(uint8_t fallback);
+  bool startServers();
   void handleClient();
   void releaseResources();
 
   // Request handlers
   void handleRootRequest();
+  void handleProbeRequest();
   void handleConnectRequest();
+  void handleConfigureRequest();
+  void handleUpdateRequest();
+  void handleNetworksRequest();
+  void handleNetworksJsonRequest();
+  void handleMetricsRequest();
 
   // Utility functions
-  String loadHTMLTemplate();
-  String getFallbackHTML();
-  String generateNetworksList(bool forceRefresh = false);
-  String getSignalStrength(int rssi);
+  bool loadHTMLTemplate();
+  bool attachEmbeddedPage();
+  bool updateScanCache(bool forceRefresh = false);
+  bool startScan(size_t pass);
+  size_t scanPassCount() const;
+  bool hasScanResults();
+  void requestScanRefresh();
+  bool sendGzipPage();
+  bool sendNotModified(const char* etag);
+  void computeETags();
+  void writeTemplate(ResponseWriter& out, bool loading);
+  void writeSlot(ResponseWriter& out, uint8_t slot, bool loading); // HtmlTemplate::Slot
+  void writeNetworksList(ResponseWriter& out, bool loading);
+  void writeBuiltinPortal(ResponseWriter& out);
+  void writeJsonEscaped(ResponseWriter& out, const char* text);
+  void writeHtmlEscaped(ResponseWriter& out, const char* text);
+  void writeVerifySteps(ResponseWriter& out, bool html);
+  const char* getSignalStrength(int rssi);
+  int getSignalLevel(int rssi);
 
   const char* _apName;
-  WebServer* _server;
-  DNSServer* _dnsServer;
+  Config _config;
+  PortalServer* _server;
+  CaptiveDns* _dnsServer;
+  HtmlTemplate* _template;
+  HtmlTemplate* _gzipPage;
   IPAddress _apIP;
   IPAddress _netMask;
+  char _portalUrl[24];  // "http://<apIP>/"
+  char _pageETag[11];   // Quoted digest of the identity page, empty when it is dynamic
+  char _gzipETag[11];
 
   // State variables
-  bool _credentialsReceived;
+  bool _running;
+  std::atomic<bool> _credentialsReceived;  // Set by handlers, which may run on another task
   WiFiCredentials _credentials;
+  unsigned long _credentialsSeenAt;
+  CredentialsCallback _onCredentials;
+
+  // Portal task mode; the queue carries one bool when the task is done.
+  // The task then suspends itself and is deleted by its owner, so _task
+  // stays valid until collectPortalTask().
+  TaskHandle_t _task;
+  QueueHandle_t _taskDone;
+  std::atomic<bool> _taskExited;
+
+  // Idle polling: the task pumping the portal sleeps in waitForWork() and
+  // is notified from the WiFi event task when a station joins
+  std::atomic<TaskHandle_t> _pumpTask;
+  size_t _stationEventId; // wifi_event_id_t, 0 when not registered
+  unsigned long _portalStartedAt;
+
+  HeapStats _heapStats;
+  size_t _heapLowWaterAtStart;  // ESP.getMinFreeHeap() when begin() was called
+  size_t _heapBudget;           // HEAP_BUDGET as enforced this session, 0 for none
+  Stats _stats;
+  // What getStats() and getHeapStats() hand out, see publishStats()
+  mutable portMUX_TYPE _statsLock;
+  HeapStats _heapSnapshot;
+  Stats _statsSnapshot;
+  uint32_t _scanStartedAt; // micros(), 0 when not timing a scan
 
   // Network scanning cache
-  String _cachedNetworksList;
-  unsigned long _lastScanTime;
-  static const unsigned long SCAN_INTERVAL = 30000; // 30 seconds
+  ScanCache* _scanCache;
+  FanoutLink* _fanout;
+  std::atomic<bool> _scanRefreshRequested;
+  size_t _scanPass; // Pass of the current scan, see Config::SCAN_CHANNELS
+  bool _scanStaged; // A finished scan waits in the cache's staging set
+  static const unsigned long SCAN_WAIT_TIMEOUT = 10000; // Longest /update waits for a scan
+  static const uint32_t TASK_STOP_BIT = 1 << 0;
+  static const uint32_t STATION_JOINED_BIT = 1 << 1;
+  static const unsigned long CLIENT_POLL_MS = 10; // Longest sleep while a client is associated
+  static const uint32_t AP_START_TIMEOUT = 2000; // ms
+  static const unsigned long ASYNC_RESPONSE_GRACE = 250; // ms
+  static const unsigned long ASYNC_RESPONSE_TIMEOUT = 3000; // ms
+  static const size_t MAX_CONFIGURE_BODY = 512; // JSON from the portal page, escapes included
+
+  // Station join attempt for submitted credentials, see VERIFY_CONNECTION.
+  // Handlers request it, the pump runs it.
+  enum VerifyState : uint8_t { VERIFY_IDLE, VERIFY_REQUESTED, VERIFY_RUNNING, VERIFY_PASSED, VERIFY_FAILED };
+  std::atomic<uint8_t> _verifyState;
+  // How far the join got, streamed to the waiting client as it happens
+  enum VerifyStep : uint8_t { VERIFY_STEP_NONE, VERIFY_STEP_CONNECTING, VERIFY_STEP_ASSOCIATED, VERIFY_STEP_GOT_IP };
+  std::atomic<uint8_t> _verifyStep;
+  IPAddress _verifyAddress; // Set before _verifyStep reaches VERIFY_STEP_GOT_IP
+  WiFiSsid _verifySsid;
+  WiFiPassword _verifyPassword;
+  const char* _verifyReason;
+  unsigned long _verifyStartedAt;
 };
 
 #endif // WIFIPROVISIONER_H
\ No newline at end of file
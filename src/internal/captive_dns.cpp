@@ -0,0 +1,144 @@
+#include "captive_dns.h"
+#include <lwip/sockets.h>
+
+namespace {
+
+const size_t HEADER_SIZE = 12;
+const size_t ANSWER_SIZE = 16;  // Name pointer, type, class, TTL, length, IPv4
+
+const uint16_t TYPE_A = 1;
+const uint16_t CLASS_IN = 1;
+
+uint16_t readU16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void writeU16(uint8_t* p, uint16_t value) {
+  p[0] = static_cast<uint8_t>(value >> 8);
+  p[1] = static_cast<uint8_t>(value);
+}
+
+} // namespace
+
+CaptiveDns::CaptiveDns() : _socket(-1), _ip{0, 0, 0, 0} {}
+
+CaptiveDns::~CaptiveDns() {
+  stop();
+}
+
+bool CaptiveDns::start(uint16_t port, const IPAddress& ip) {
+  stop();
+
+  for (int i = 0; i < 4; i++) {
+    _ip[i] = ip[i];
+  }
+
+  _socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (_socket < 0) {
+    return false;
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (::bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+    stop();
+    return false;
+  }
+
+  fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void CaptiveDns::stop() {
+  if (_socket >= 0) {
+    ::close(_socket);
+    _socket = -1;
+  }
+}
+
+size_t CaptiveDns::processPending() {
+  if (_socket < 0) {
+    return 0;
+  }
+
+  size_t answered = 0;
+  for (size_t i = 0; i < MAX_QUERIES_PER_POLL; i++) {
+    sockaddr_in client = {};
+    socklen_t clientLength = sizeof(client);
+    ssize_t received = ::recvfrom(_socket, _buffer, sizeof(_buffer), 0,
+                                  reinterpret_cast<sockaddr*>(&client), &clientLength);
+    if (received <= 0) {
+      break;  // Nothing left (EWOULDBLOCK) or a socket error
+    }
+
+    size_t length = buildResponse(static_cast<size_t>(received));
+    if (length == 0) {
+      continue;
+    }
+
+    ::sendto(_socket, _buffer, length, 0, reinterpret_cast<sockaddr*>(&client), clientLength);
+    answered++;
+  }
+  return answered;
+}
+
+size_t CaptiveDns::buildResponse(size_t length) {
+  if (length < HEADER_SIZE) {
+    return 0;
+  }
+
+  // Only standard queries (QR = 0, opcode 0) with a single question
+  uint8_t flags = _buffer[2];
+  if ((flags & 0x80) || (flags & 0x78) || readU16(_buffer + 4) != 1) {
+    return 0;
+  }
+
+  // Walk the question name; compression pointers are not valid here
+  size_t pos = HEADER_SIZE;
+  while (pos < length && _buffer[pos] != 0) {
+    if (_buffer[pos] & 0xC0) {
+      return 0;
+    }
+    pos += _buffer[pos] + 1;
+  }
+  pos++;  // Terminating zero label
+  if (pos + 4 > length) {
+    return 0;
+  }
+
+  uint16_t type = readU16(_buffer + pos);
+  uint16_t qclass = readU16(_buffer + pos + 2);
+  pos += 4;
+
+  bool answer = (type == TYPE_A && qclass == CLASS_IN);
+
+  // Response header: QR and AA set, RD copied, RA set, RCODE NOERROR.
+  // Anything after the question (e.g. an EDNS OPT record) is dropped.
+  _buffer[2] = static_cast<uint8_t>(0x84 | (flags & 0x01));
+  _buffer[3] = 0x80;
+  writeU16(_buffer + 6, answer ? 1 : 0);
+  writeU16(_buffer + 8, 0);
+  writeU16(_buffer + 10, 0);
+
+  if (!answer) {
+    return pos;
+  }
+
+  if (pos + ANSWER_SIZE > sizeof(_buffer)) {
+    return 0;
+  }
+
+  uint8_t* record = _buffer + pos;
+  writeU16(record, 0xC000 | HEADER_SIZE);  // Pointer to the question name
+  writeU16(record + 2, TYPE_A);
+  writeU16(record + 4, CLASS_IN);
+  writeU16(record + 6, static_cast<uint16_t>(ANSWER_TTL >> 16));
+  writeU16(record + 8, static_cast<uint16_t>(ANSWER_TTL));
+  writeU16(record + 10, 4);
+  memcpy(record + 12, _ip, 4);
+
+  return pos + ANSWER_SIZE;
+}
@@ -0,0 +1,39 @@
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// Minimal captive-portal DNS responder. Every A query is answered with the
+// portal address, and every other type (AAAA, HTTPS, ...) gets an empty
+// NOERROR answer, so clients do not wait on IPv6 or SVCB lookups that can
+// never succeed. Packets are parsed and answered in place in one static
+// buffer, and each poll drains every query waiting on the socket.
+class CaptiveDns {
+public:
+  // Upper bound per poll so a query flood cannot starve the HTTP server
+  static const size_t MAX_QUERIES_PER_POLL = 16;
+  static const uint32_t ANSWER_TTL = 60;  // seconds
+
+  CaptiveDns();
+  ~CaptiveDns();
+
+  bool start(uint16_t port, const IPAddress& ip);
+  void stop();
+
+  // Answers the queries waiting on the socket; returns how many were answered
+  size_t processPending();
+
+  int socket() const { return _socket; }
+
+private:
+  // Rewrites the query in _buffer into its response and returns the
+  // response length, or 0 if the packet should be dropped
+  size_t buildResponse(size_t length);
+
+  int _socket;
+  uint8_t _ip[4];
+  uint8_t _buffer[512];  // Largest plain UDP DNS message
+};
+
+#endif // CAPTIVE_DNS_H
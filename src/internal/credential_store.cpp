@@ -0,0 +1,49 @@
+#include "credential_store.h"
+#include <Preferences.h>
+
+bool CredentialStore::load(StoredNetwork& network) {
+  memset(&network, 0, sizeof(network));
+
+  Preferences prefs;
+  if (!prefs.begin(_namespace, true)) {
+    return false;
+  }
+
+  bool found = prefs.getString("ssid", network.ssid, sizeof(network.ssid)) > 0;
+  if (found) {
+    prefs.getString("pass", network.password, sizeof(network.password));
+    network.hasBssid = prefs.getBytes("bssid", network.bssid, sizeof(network.bssid)) == sizeof(network.bssid);
+    network.channel = prefs.getUChar("chan", 0);
+  }
+
+  prefs.end();
+  return found && network.ssid[0] != '\0';
+}
+
+bool CredentialStore::save(const StoredNetwork& network) {
+  Preferences prefs;
+  if (!prefs.begin(_namespace, false)) {
+    return false;
+  }
+
+  bool ok = prefs.putString("ssid", network.ssid) > 0;
+  // An open network has an empty password, which putString() reports as 0
+  prefs.putString("pass", network.password);
+  if (network.hasBssid) {
+    ok = ok && prefs.putBytes("bssid", network.bssid, sizeof(network.bssid)) == sizeof(network.bssid);
+  } else {
+    prefs.remove("bssid");
+  }
+  prefs.putUChar("chan", network.channel);
+
+  prefs.end();
+  return ok;
+}
+
+void CredentialStore::clear() {
+  Preferences prefs;
+  if (prefs.begin(_namespace, false)) {
+    prefs.clear();
+    prefs.end();
+  }
+}
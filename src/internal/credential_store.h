@@ -0,0 +1,30 @@
+#ifndef CREDENTIAL_STORE_H
+#define CREDENTIAL_STORE_H
+
+#include <Arduino.h>
+
+// Network the device last connected to, as kept in NVS
+struct StoredNetwork {
+  char ssid[33];
+  char password[65];
+  uint8_t bssid[6];
+  uint8_t channel;    // 0 when unknown
+  bool hasBssid;
+};
+
+// Persists the last working network in an NVS namespace via Preferences,
+// so a reboot can associate straight away instead of opening the portal.
+class CredentialStore {
+public:
+  explicit CredentialStore(const char* ns) : _namespace(ns) {}
+
+  // Returns false when nothing (or only a partial record) is stored
+  bool load(StoredNetwork& network);
+  bool save(const StoredNetwork& network);
+  void clear();
+
+private:
+  const char* _namespace;
+};
+
+#endif // CREDENTIAL_STORE_H
@@ -0,0 +1,302 @@
+#include "fanout_link.h"
+#include "secure_wipe.h"
+#include <esp_idf_version.h>
+#include <esp_wifi.h>
+#include <mbedtls/md.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+namespace {
+
+const char MAGIC[4] = {'W', 'P', 'F', 'O'};
+const uint8_t BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+const size_t TAG_LENGTH = 8;
+
+enum Type : uint8_t { HELLO = 1, OFFER, READY, CREDENTIALS };
+
+struct __attribute__((packed)) Message {
+  char magic[4];
+  uint8_t type;
+  uint8_t target[6];         // OFFER: the receiver it is meant for
+  char ssid[33];             // CREDENTIALS only, NUL-terminated
+  char password[65];
+  uint8_t tag[TAG_LENGTH];   // Truncated HMAC-SHA256 of ssid and password
+};
+
+// Header-only messages stop before the credentials
+const size_t SHORT_LENGTH = offsetof(Message, ssid);
+
+struct Frame {
+  uint8_t mac[6];
+  uint8_t length;
+  uint8_t data[sizeof(Message)];
+};
+
+// Filled by the WiFi task, drained by the poll functions
+QueueHandle_t rxQueue = nullptr;
+
+void queueFrame(const uint8_t* mac, const uint8_t* data, int length) {
+  if (!rxQueue || length < static_cast<int>(SHORT_LENGTH) || length > static_cast<int>(sizeof(Message)) ||
+      memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+    return;
+  }
+  Frame frame;
+  memcpy(frame.mac, mac, sizeof(frame.mac));
+  frame.length = static_cast<uint8_t>(length);
+  memcpy(frame.data, data, length);
+  xQueueSend(rxQueue, &frame, 0);
+  secureWipe(&frame, sizeof(frame));
+}
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+void onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int length) {
+  queueFrame(info->src_addr, data, length);
+}
+#else
+void onReceive(const uint8_t* mac, const uint8_t* data, int length) {
+  queueFrame(mac, data, length);
+}
+#endif
+
+} // namespace
+
+FanoutLink::FanoutLink()
+  : _role(RECEIVER), _running(false), _interface(WIFI_IF_STA), _lastHello(0),
+    _recentCount(0), _served(0) {
+  memset(_peers, 0, sizeof(_peers));
+}
+
+FanoutLink::~FanoutLink() {
+  end();
+}
+
+bool FanoutLink::begin(Role role, const char* key, bool apInterface) {
+  if (_running || rxQueue || !key || !*key) {
+    return false;
+  }
+
+  const mbedtls_md_info_t* sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  if (mbedtls_md(sha256, reinterpret_cast<const unsigned char*>(key), strlen(key), _key) != 0) {
+    return false;
+  }
+
+  _role = role;
+  _interface = apInterface ? WIFI_IF_AP : WIFI_IF_STA;
+  esp_wifi_get_mac(_interface, _ownMac);
+
+  if (esp_now_init() != ESP_OK) {
+    return false;
+  }
+  esp_now_set_pmk(_key + ESP_NOW_KEY_LEN);
+
+  rxQueue = xQueueCreate(4, sizeof(Frame));
+  if (!rxQueue) {
+    esp_now_deinit();
+    return false;
+  }
+  // ESP-NOW and the queue are ours from here, so end() undoes them
+  _running = true;
+  if (!addPeer(BROADCAST, false)) {
+    end();
+    return false;
+  }
+  esp_now_register_recv_cb(onReceive);
+
+  _lastHello = 0;
+  _served = 0;
+  _recentCount = 0;
+  memset(_peers, 0, sizeof(_peers));
+  return true;
+}
+
+void FanoutLink::end() {
+  // A link whose begin() failed, e.g. because another one is active, owns
+  // none of the shared ESP-NOW state and must leave it alone
+  if (!_running) {
+    return;
+  }
+  _running = false;
+
+  esp_now_unregister_recv_cb();
+  esp_now_deinit();
+
+  // Receiving leaves each frame's bytes in the queue's storage, so drain it
+  // and then fill every slot with zeros before freeing it
+  Frame frame;
+  while (xQueueReceive(rxQueue, &frame, 0) == pdTRUE) {}
+  memset(&frame, 0, sizeof(frame));
+  while (xQueueSend(rxQueue, &frame, 0) == pdTRUE) {}
+  vQueueDelete(rxQueue);
+  rxQueue = nullptr;
+  secureWipe(_key, sizeof(_key));
+}
+
+bool FanoutLink::pollReceiver(char* ssid, size_t ssidSize, char* password, size_t passwordSize) {
+  if (!_running) {
+    return false;
+  }
+
+  if (_lastHello == 0 || millis() - _lastHello >= HELLO_INTERVAL) {
+    send(BROADCAST, HELLO, nullptr, nullptr, nullptr);
+    _lastHello = millis() | 1;
+  }
+
+  Frame frame;
+  while (xQueueReceive(rxQueue, &frame, 0) == pdTRUE) {
+    const Message& message = *reinterpret_cast<const Message*>(frame.data);
+
+    if (message.type == OFFER && memcmp(message.target, _ownMac, sizeof(_ownMac)) == 0) {
+      // Encrypted from here on; a coordinator with another key can't read READY
+      if (addPeer(frame.mac, true)) {
+        send(frame.mac, READY, nullptr, nullptr, nullptr);
+      }
+    } else if (message.type == CREDENTIALS && frame.length == sizeof(Message)) {
+      Message copy = message;
+      copy.ssid[sizeof(copy.ssid) - 1] = '\0';
+      copy.password[sizeof(copy.password) - 1] = '\0';
+
+      uint8_t tag[TAG_LENGTH];
+      sign(copy.ssid, copy.password, tag);
+      esp_now_del_peer(frame.mac);
+      bool valid = memcmp(tag, copy.tag, sizeof(tag)) == 0 && copy.ssid[0] != '\0';
+      if (valid) {
+        strlcpy(ssid, copy.ssid, ssidSize);
+        strlcpy(password, copy.password, passwordSize);
+      }
+      secureWipe(&copy, sizeof(copy));
+      secureWipe(&frame, sizeof(frame));
+      if (valid) {
+        return true;
+      }
+    }
+  }
+  secureWipe(&frame, sizeof(frame));
+  return false;
+}
+
+void FanoutLink::pollCoordinator(const char* ssid, const char* password) {
+  if (!_running) {
+    return;
+  }
+
+  expirePeers();
+
+  Frame frame;
+  while (xQueueReceive(rxQueue, &frame, 0) == pdTRUE) {
+    const Message& message = *reinterpret_cast<const Message*>(frame.data);
+    Peer* peer = findPeer(frame.mac);
+
+    if (message.type == HELLO && !peer) {
+      // Claim a slot, then name the receiver in a broadcast OFFER since it
+      // can't decrypt anything from us until it has added us as a peer
+      for (Peer& slot : _peers) {
+        if (slot.active) continue;
+        if (!addPeer(frame.mac, true)) break;
+        memcpy(slot.mac, frame.mac, sizeof(slot.mac));
+        slot.since = millis();
+        slot.active = true;
+        slot.sent = false;
+        send(BROADCAST, OFFER, frame.mac, nullptr, nullptr);
+        break;
+      }
+    } else if (message.type == READY && peer && !peer->sent) {
+      // READY arrived encrypted, so the receiver holds the same key
+      if (send(frame.mac, CREDENTIALS, nullptr, ssid, password)) {
+        peer->sent = true;
+        peer->since = millis();
+        rememberServed(frame.mac);
+      }
+    }
+  }
+}
+
+bool FanoutLink::addPeer(const uint8_t* mac, bool encrypt) {
+  esp_now_peer_info_t peer;
+  memset(&peer, 0, sizeof(peer));
+  memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+  peer.channel = 0;  // Current channel
+  peer.ifidx = _interface;
+  peer.encrypt = encrypt;
+  if (encrypt) {
+    memcpy(peer.lmk, _key, ESP_NOW_KEY_LEN);
+  }
+
+  if (esp_now_is_peer_exist(mac)) {
+    return esp_now_mod_peer(&peer) == ESP_OK;
+  }
+  return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+bool FanoutLink::send(const uint8_t* mac, uint8_t type, const uint8_t* target,
+                      const char* ssid, const char* password) {
+  Message message;
+  memset(&message, 0, sizeof(message));
+  memcpy(message.magic, MAGIC, sizeof(MAGIC));
+  message.type = type;
+  if (target) {
+    memcpy(message.target, target, sizeof(message.target));
+  }
+
+  size_t length = SHORT_LENGTH;
+  if (type == CREDENTIALS) {
+    strlcpy(message.ssid, ssid, sizeof(message.ssid));
+    strlcpy(message.password, password, sizeof(message.password));
+    sign(message.ssid, message.password, message.tag);
+    length = sizeof(message);
+  }
+
+  // esp_now_send() copies the frame, so the credentials can go right away
+  bool sent = esp_now_send(mac, reinterpret_cast<const uint8_t*>(&message), length) == ESP_OK;
+  secureWipe(&message, sizeof(message));
+  return sent;
+}
+
+void FanoutLink::sign(const char* ssid, const char* password, uint8_t* tag) {
+  // ssid and password are NUL-terminated, so hashing the terminator as well
+  // keeps "ab"+"c" and "a"+"bc" apart
+  unsigned char input[33 + 65];
+  size_t ssidLength = strlen(ssid) + 1;
+  size_t passwordLength = strlen(password) + 1;
+  memcpy(input, ssid, ssidLength);
+  memcpy(input + ssidLength, password, passwordLength);
+
+  unsigned char digest[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), _key, sizeof(_key),
+                  input, ssidLength + passwordLength, digest);
+  memcpy(tag, digest, TAG_LENGTH);
+  secureWipe(input, sizeof(input));
+  secureWipe(digest, sizeof(digest));
+}
+
+FanoutLink::Peer* FanoutLink::findPeer(const uint8_t* mac) {
+  for (Peer& peer : _peers) {
+    if (peer.active && memcmp(peer.mac, mac, sizeof(peer.mac)) == 0) {
+      return &peer;
+    }
+  }
+  return nullptr;
+}
+
+void FanoutLink::expirePeers() {
+  // Handshakes that stalled, e.g. on a key mismatch, and peers whose
+  // credentials have had time to go out
+  for (Peer& peer : _peers) {
+    if (peer.active && millis() - peer.since >= PEER_TIMEOUT) {
+      esp_now_del_peer(peer.mac);
+      peer.active = false;
+    }
+  }
+}
+
+void FanoutLink::rememberServed(const uint8_t* mac) {
+  // Receivers keep announcing until their portal closes, so count each once
+  const size_t capacity = sizeof(_recentlyServed) / sizeof(_recentlyServed[0]);
+  for (size_t i = 0; i < _recentCount && i < capacity; i++) {
+    if (memcmp(_recentlyServed[i], mac, 6) == 0) {
+      return;
+    }
+  }
+  memcpy(_recentlyServed[_recentCount % capacity], mac, 6);
+  _recentCount++;
+  _served++;
+}
@@ -0,0 +1,75 @@
+#ifndef FANOUT_LINK_H
+#define FANOUT_LINK_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+
+// ESP-NOW link that lets one provisioned device hand its credentials to
+// nearby portals sharing the same key, so a batch of units is set up once.
+//
+//   receiver     HELLO (broadcast)               -> coordinator
+//   coordinator  OFFER (broadcast, names target) -> receiver
+//   receiver     READY (encrypted unicast)       -> coordinator
+//   coordinator  CREDENTIALS (encrypted unicast) -> receiver
+//
+// Both sides derive the ESP-NOW PMK/LMK from the shared key, so READY and
+// CREDENTIALS only get through between matching keys, and CREDENTIALS also
+// carries an HMAC of its contents. ESP-NOW sends on the current channel:
+// receivers' APs must be on the channel of the network the coordinator is
+// connected to (e.g. Config::AP_CHANNEL_FROM_SCAN).
+//
+// ESP-NOW callbacks carry no context, so only one link can be active.
+class FanoutLink {
+public:
+  enum Role { RECEIVER, COORDINATOR };
+
+  static const unsigned long HELLO_INTERVAL = 1000; // ms
+  static const unsigned long PEER_TIMEOUT = 3000;   // ms
+  static const size_t MAX_PEERS = 4;                // Handshakes in flight
+
+  FanoutLink();
+  ~FanoutLink();
+
+  // apInterface selects the softAP interface, as used by a running portal
+  bool begin(Role role, const char* key, bool apInterface);
+  void end();
+
+  // Receiver: announces itself and returns true once credentials arrived
+  bool pollReceiver(char* ssid, size_t ssidSize, char* password, size_t passwordSize);
+  // Coordinator: answers announcements with these credentials
+  void pollCoordinator(const char* ssid, const char* password);
+  // Distinct devices the coordinator has sent credentials to
+  size_t served() const { return _served; }
+
+private:
+  struct Peer {
+    uint8_t mac[6];
+    unsigned long since;
+    bool active;
+    bool sent;
+  };
+
+  bool addPeer(const uint8_t* mac, bool encrypt);
+  bool send(const uint8_t* mac, uint8_t type, const uint8_t* target,
+            const char* ssid, const char* password);
+  void sign(const char* ssid, const char* password, uint8_t* tag);
+  Peer* findPeer(const uint8_t* mac);
+  void expirePeers();
+  void rememberServed(const uint8_t* mac);
+
+  Role _role;
+  bool _running;
+  wifi_interface_t _interface;
+  uint8_t _ownMac[6];
+  uint8_t _key[32];   // SHA-256 of the shared key: LMK, then PMK
+  unsigned long _lastHello;
+  Peer _peers[MAX_PEERS];
+  uint8_t _recentlyServed[8][6];
+  size_t _recentCount;
+  size_t _served;
+
+  FanoutLink(const FanoutLink&) = delete;
+  FanoutLink& operator=(const FanoutLink&) = delete;
+};
+
+#endif // FANOUT_LINK_H
@@ -0,0 +1,67 @@
+#ifndef FIXED_RESPONSES_H
+#define FIXED_RESPONSES_H
+
+#include "portal_server.h"
+
+// Every reply the portal sends that never changes, sent with
+// PortalServer::send(), and the fixed pieces of streamed ones. The bodies
+// stay in flash with their lengths worked out at compile time.
+
+#define FIXED_RESPONSE(name, code, type, cache, text)                    \
+  static const char name##_BODY[] PROGMEM = text;                        \
+  static const FixedResponse name = {code, type, cache, name##_BODY,     \
+                                     sizeof(name##_BODY) - 1}
+
+// Without VERIFY_CONNECTION nothing has been tried yet when this is sent
+FIXED_RESPONSE(SUCCESS_PAGE, 200, "text/html", nullptr, R"(
+<!DOCTYPE html>
+<html>
+<head><title>Success</title></head>
+<body style="font-family: Arial; text-align: center; padding: 50px;">
+  <h1 style="color: green;">✓ Credentials Saved!</h1>
+  <p>WiFi credentials have been saved successfully.</p>
+  <p>The device will now attempt to connect...</p>
+</body>
+</html>)");
+
+// The verified /connect answer is streamed in pieces: the head, a line for
+// each step of the join as it is reached, then one of the endings
+static const char CONNECT_PROGRESS_HEAD[] PROGMEM = R"(<!DOCTYPE html>
+<html>
+<head><meta charset="utf-8"><title>Connecting</title></head>
+<body style="font-family: Arial; text-align: center; padding: 50px;">
+)";
+static const char CONNECT_STEP_CONNECTING[] PROGMEM = "  <p>Connecting and checking the credentials...</p>\n";
+static const char CONNECT_STEP_ASSOCIATED[] PROGMEM = "  <p>Credentials accepted, getting an IP address...</p>\n";
+
+static const char CONNECT_SUCCEEDED_TAIL[] PROGMEM = R"(  <h1 style="color: green;">✓ Connected!</h1>
+  <p>The device has joined the network and saved the credentials.</p>
+</body>
+</html>)";
+
+static const char CONNECT_FAILED_TAIL[] PROGMEM = R"(  <h1 style="color: firebrick;">✗ Couldn't Connect</h1>
+  <p>Check the network name and password and try again.</p>
+  <p><a href="/">Back</a></p>
+</body>
+</html>)";
+
+// Captive portal probes get a redirect, with Location added per portal
+FIXED_RESPONSE(PROBE_REDIRECT, 302, "text/plain", "no-store", "");
+FIXED_RESPONSE(NOT_MODIFIED, 304, "text/html", "no-cache", "");
+FIXED_RESPONSE(NOT_FOUND, 404, "text/plain", nullptr, "Not found");
+
+// /connect
+FIXED_RESPONSE(MISSING_SSID, 400, "text/plain", nullptr, "Missing SSID");
+FIXED_RESPONSE(SSID_TOO_LONG, 400, "text/plain", nullptr, "SSID too long");
+FIXED_RESPONSE(PASSWORD_TOO_LONG, 400, "text/plain", nullptr, "Password too long");
+FIXED_RESPONSE(CONNECT_BUSY, 409, "text/plain", nullptr, "A connection attempt is already in progress");
+
+// /configure, answered as JSON the page reads "reason" from
+FIXED_RESPONSE(CONFIGURE_OK, 200, "application/json", nullptr, "{\"success\":true}");
+FIXED_RESPONSE(CONFIGURE_BUSY, 200, "application/json", nullptr, "{\"success\":false,\"reason\":\"busy\"}");
+FIXED_RESPONSE(CONFIGURE_BAD_PAYLOAD, 400, "application/json", nullptr, "{\"success\":false,\"reason\":\"payload\"}");
+FIXED_RESPONSE(CONFIGURE_BAD_SSID, 400, "application/json", nullptr, "{\"success\":false,\"reason\":\"ssid\"}");
+
+#undef FIXED_RESPONSE
+
+#endif // FIXED_RESPONSES_H
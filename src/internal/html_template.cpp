@@ -0,0 +1,166 @@
+#include "html_template.h"
+#include <new>
+
+namespace {
+
+struct Placeholder {
+  const char* token;
+  size_t length;
+  HtmlTemplate::Slot slot;
+};
+
+#define PLACEHOLDER(name) {"{{" #name "}}", sizeof("{{" #name "}}") - 1, HtmlTemplate::SLOT_##name}
+
+const Placeholder PLACEHOLDERS[] = {
+  PLACEHOLDER(NETWORKS_LIST),
+  PLACEHOLDER(HTML_TITLE),
+  PLACEHOLDER(THEME_COLOR),
+  PLACEHOLDER(SVG_LOGO),
+  PLACEHOLDER(PROJECT_TITLE),
+  PLACEHOLDER(PROJECT_SUB_TITLE),
+  PLACEHOLDER(PROJECT_INFO),
+  PLACEHOLDER(FOOTER_TEXT),
+  PLACEHOLDER(CONNECTION_SUCCESSFUL),
+};
+
+#undef PLACEHOLDER
+
+const Placeholder* matchPlaceholder(const char* text, size_t remaining) {
+  for (const Placeholder& placeholder : PLACEHOLDERS) {
+    if (remaining >= placeholder.length &&
+        memcmp(text, placeholder.token, placeholder.length) == 0) {
+      return &placeholder;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+HtmlTemplate::HtmlTemplate()
+  : _data(nullptr), _attached(false), _length(0), _literalLength(0), _segmentCount(0) {}
+
+HtmlTemplate::~HtmlTemplate() {
+  clear();
+}
+
+bool HtmlTemplate::load(fs::FS& fs, const char* path, bool splitPlaceholders, size_t maxLength) {
+  clear();
+
+  File file = fs.open(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  // Checked before allocating, so an oversized file costs nothing
+  size_t size = file.size();
+  if (size == 0 || (maxLength && size + 1 > maxLength)) {
+    file.close();
+    return false;
+  }
+
+  // Out of memory is one more reason to fall back, not to abort
+  _data = new (std::nothrow) char[size + 1];
+  if (!_data) {
+    file.close();
+    return false;
+  }
+  size_t bytesRead = file.read(reinterpret_cast<uint8_t*>(_data), size);
+  file.close();
+
+  if (bytesRead != size) {
+    clear();
+    return false;
+  }
+
+  _data[size] = '\0';
+  _length = size;
+  split(splitPlaceholders);
+  return true;
+}
+
+bool HtmlTemplate::hasSlot(Slot slot) const {
+  for (size_t i = 0; i < _segmentCount; i++) {
+    if (_segments[i].slot == slot) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HtmlTemplate::attach(const char* data, size_t length, const Segment* segments, size_t segmentCount) {
+  clear();
+
+  if (!data || length == 0 || !segments || segmentCount == 0 || segmentCount > MAX_SEGMENTS) {
+    return false;
+  }
+
+  // Rendering trusts the table, so a stale or hand-edited one must not
+  // point outside the page or at a slot that doesn't exist
+  for (size_t i = 0; i < segmentCount; i++) {
+    const Segment& segment = segments[i];
+    if (segment.offset > length || segment.length > length - segment.offset ||
+        segment.slot > SLOT_LAST) {
+      return false;
+    }
+  }
+
+  _data = const_cast<char*>(data);
+  _attached = true;
+  _length = length;
+  for (size_t i = 0; i < segmentCount; i++) {
+    _segments[i] = segments[i];
+    _literalLength += segments[i].length;
+  }
+  _segmentCount = segmentCount;
+  return true;
+}
+
+void HtmlTemplate::clear() {
+  if (!_attached) {
+    delete[] _data;
+  }
+  _data = nullptr;
+  _attached = false;
+  _length = 0;
+  _literalLength = 0;
+  _segmentCount = 0;
+}
+
+void HtmlTemplate::split(bool splitPlaceholders) {
+  size_t literalStart = 0;
+  size_t pos = splitPlaceholders ? 0 : _length;
+
+  // The last segment is reserved for the trailing literal, so at most
+  // MAX_SEGMENTS - 1 placeholders are recognised; any further ones are
+  // left in the output as plain text.
+  while (pos + 1 < _length && _segmentCount < MAX_SEGMENTS - 1) {
+    if (_data[pos] != '{' || _data[pos + 1] != '{') {
+      pos++;
+      continue;
+    }
+
+    const Placeholder* placeholder = matchPlaceholder(_data + pos, _length - pos);
+    if (!placeholder) {
+      pos++;
+      continue;
+    }
+
+    _segments[_segmentCount++] = {
+      static_cast<uint32_t>(literalStart),
+      static_cast<uint32_t>(pos - literalStart),
+      placeholder->slot
+    };
+    _literalLength += pos - literalStart;
+
+    pos += placeholder->length;
+    literalStart = pos;
+  }
+
+  _segments[_segmentCount++] = {
+    static_cast<uint32_t>(literalStart),
+    static_cast<uint32_t>(_length - literalStart),
+    SLOT_NONE
+  };
+  _literalLength += _length - literalStart;
+}
@@ -0,0 +1,81 @@
+#ifndef HTML_TEMPLATE_H
+#define HTML_TEMPLATE_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+#ifndef WIFI_PROV_MAX_TEMPLATE_SEGMENTS
+#define WIFI_PROV_MAX_TEMPLATE_SEGMENTS 24
+#endif
+
+// Portal template loaded once into a single buffer and pre-split at its
+// {{PLACEHOLDER}} markers. Rendering walks the segment table, so a request
+// never touches the filesystem or copies the template.
+class HtmlTemplate {
+public:
+  enum Slot : uint8_t {
+    SLOT_NONE = 0,              // Literal only, nothing follows it
+    SLOT_NETWORKS_LIST,         // {{NETWORKS_LIST}}, the only per-request slot
+    SLOT_HTML_TITLE,            // {{HTML_TITLE}} and the rest map to Config
+    SLOT_THEME_COLOR,
+    SLOT_SVG_LOGO,
+    SLOT_PROJECT_TITLE,
+    SLOT_PROJECT_SUB_TITLE,
+    SLOT_PROJECT_INFO,
+    SLOT_FOOTER_TEXT,
+    SLOT_CONNECTION_SUCCESSFUL,
+    SLOT_LAST = SLOT_CONNECTION_SUCCESSFUL
+  };
+
+  // A literal run of the template followed by the slot that comes after it
+  struct Segment {
+    uint32_t offset;
+    uint32_t length;
+    Slot slot;
+  };
+
+  static const size_t MAX_SEGMENTS = WIFI_PROV_MAX_TEMPLATE_SEGMENTS;
+
+  HtmlTemplate();
+  ~HtmlTemplate();
+
+  // Reads the whole file and splits it. Returns false if the file is
+  // missing, empty, larger than maxLength (when non-zero), could not be
+  // allocated or read; the template is then left empty. With splitPlaceholders false the
+  // file is kept as one literal segment, which is how binary assets such as
+  // pre-gzipped pages are held.
+  bool load(fs::FS& fs, const char* path, bool splitPlaceholders = true, size_t maxLength = 0);
+  // Uses a page already in flash, e.g. one generated by
+  // extras/embed_template.py, together with its precomputed segment table.
+  // Nothing is copied or parsed; the data must outlive the template.
+  // Returns false, leaving the template empty, if a segment lies outside
+  // the data or names an unknown slot.
+  bool attach(const char* data, size_t length, const Segment* segments, size_t segmentCount);
+  void clear();
+
+  bool isLoaded() const { return _data != nullptr; }
+  const char* data() const { return _data; }
+  size_t length() const { return _length; }
+
+  size_t segmentCount() const { return _segmentCount; }
+  const Segment& segment(size_t index) const { return _segments[index]; }
+
+  // Total bytes of literal text, i.e. the page size without slot contents
+  size_t literalLength() const { return _literalLength; }
+  bool hasSlot(Slot slot) const;
+
+private:
+  void split(bool splitPlaceholders);
+
+  char* _data;
+  bool _attached;  // _data points at flash and is not ours to free
+  size_t _length;
+  size_t _literalLength;
+  Segment _segments[MAX_SEGMENTS];
+  size_t _segmentCount;
+
+  HtmlTemplate(const HtmlTemplate&) = delete;
+  HtmlTemplate& operator=(const HtmlTemplate&) = delete;
+};
+
+#endif // HTML_TEMPLATE_H
@@ -0,0 +1,22 @@
+#ifndef PORTAL_FS_H
+#define PORTAL_FS_H
+
+// Filesystem the portal page is read from, selected at compile time:
+//   0 - SPIFFS
+//   1 - LittleFS, which opens files and reads metadata faster; data/ must
+//       then be uploaded as a LittleFS image
+#ifndef WIFI_PROV_USE_LITTLEFS
+#define WIFI_PROV_USE_LITTLEFS 0
+#endif
+
+#if WIFI_PROV_USE_LITTLEFS
+#include <LittleFS.h>
+#define PORTAL_FS LittleFS
+#define PORTAL_FS_NAME "LittleFS"
+#else
+#include <SPIFFS.h>
+#define PORTAL_FS SPIFFS
+#define PORTAL_FS_NAME "SPIFFS"
+#endif
+
+#endif // PORTAL_FS_H
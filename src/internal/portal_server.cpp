@@ -0,0 +1,428 @@
+#include "portal_server.h"
+#include "secure_wipe.h"
+
+#if WIFI_PROV_ASYNC_SERVER
+#include <freertos/semphr.h>
+
+namespace {
+
+WebRequestMethodComposite toAsyncMethod(PortalServer::Method method) {
+  switch (method) {
+    case PortalServer::GET: return HTTP_GET;
+    case PortalServer::POST: return HTTP_POST;
+    default: return HTTP_ANY;
+  }
+}
+
+// Holds the recursive stream lock for a scope. Recursive because an
+// older ESPAsyncWebServer calls the first filler from inside send().
+class StreamLock {
+public:
+  explicit StreamLock(SemaphoreHandle_t lock) : _lock(lock) { xSemaphoreTakeRecursive(_lock, portMAX_DELAY); }
+  ~StreamLock() { xSemaphoreGiveRecursive(_lock); }
+
+private:
+  SemaphoreHandle_t _lock;
+};
+
+} // namespace
+
+// Handlers, fillers and runExclusive() all hold lock. Once cancelled is set
+// nothing that could reach the portal's data runs any more.
+struct PortalStreamState {
+  PortalStreamState() : lock(xSemaphoreCreateRecursiveMutex()), active(0), cancelled(false) {}
+  ~PortalStreamState() { vSemaphoreDelete(lock); }
+
+  SemaphoreHandle_t lock;
+  std::atomic<int> active;
+  bool cancelled;
+};
+
+namespace {
+
+// Keeps isStreaming() true until the response owning the renderer is freed,
+// which also covers clients that disconnect mid-response. A response still
+// waiting to be ready arms it only once it starts rendering, so it doesn't
+// hold off the very update it waits for.
+struct StreamGuard {
+  StreamGuard(const std::shared_ptr<PortalStreamState>& state, bool armed)
+    : _state(state), _armed(false) {
+    if (armed) arm();
+  }
+  ~StreamGuard() {
+    if (_armed) _state->active--;
+  }
+  void arm() {
+    if (!_armed) {
+      _armed = true;
+      _state->active++;
+    }
+  }
+  std::shared_ptr<PortalStreamState> _state;
+  bool _armed;
+};
+
+} // namespace
+
+PortalServer::PortalServer(uint16_t port)
+  : _server(port), _request(nullptr), _pendingHeaderCount(0), _streams(std::make_shared<PortalStreamState>()),
+    _requestCount(0), _handlerMicros(0), _maxHandlerMicros(0) {}
+
+void PortalServer::on(const char* uri, Method method, Handler handler, size_t maxBody) {
+  if (maxBody == 0) {
+    _server.on(uri, toAsyncMethod(method),
+      [this, handler](AsyncWebServerRequest* request) { dispatch(request, handler); });
+    return;
+  }
+
+  _server.on(uri, toAsyncMethod(method),
+    [this, handler](AsyncWebServerRequest* request) { dispatch(request, handler); },
+    nullptr,
+    [maxBody](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+      // Collect the raw body for takeBody(); the request frees _tempObject.
+      // An oversized one is never buffered, so takeBody() finds nothing.
+      if (index == 0 && total <= maxBody) {
+        request->_tempObject = malloc(total + 1);
+      }
+      char* buffer = static_cast<char*>(request->_tempObject);
+      if (!buffer || index + len > total) return;
+      memcpy(buffer + index, data, len);
+      if (index + len == total) {
+        buffer[total] = '\0';
+      }
+    });
+}
+
+void PortalServer::onNotFound(Handler handler) {
+  _server.onNotFound([this, handler](AsyncWebServerRequest* request) { dispatch(request, handler); });
+}
+
+void PortalServer::dispatch(AsyncWebServerRequest* request, const Handler& handler) {
+  StreamLock lock(_streams->lock);
+  if (_streams->cancelled) {
+    request->send(503);
+    return;
+  }
+  _request = request;
+  runHandler(handler);
+  _request = nullptr;
+}
+
+bool PortalServer::isStreaming() const {
+  return _streams->active.load() > 0;
+}
+
+bool PortalServer::runExclusive(const std::function<void()>& change) {
+  StreamLock lock(_streams->lock);
+  if (_streams->active.load() > 0) {
+    return false;
+  }
+  change();
+  return true;
+}
+
+void PortalServer::cancelStreams() {
+  // Waits out a handler or filler that is running right now
+  StreamLock lock(_streams->lock);
+  _streams->cancelled = true;
+}
+
+void PortalServer::collectHeaders(const char* headers[], size_t count) {
+  // ESPAsyncWebServer keeps all request headers
+  (void)headers;
+  (void)count;
+}
+
+void PortalServer::begin() {
+  _server.begin();
+}
+
+void PortalServer::stop() {
+  _server.end();
+}
+
+void PortalServer::handleClient() {}
+
+String PortalServer::uri() {
+  return _request->url();
+}
+
+bool PortalServer::isPost() {
+  return _request->method() == HTTP_POST;
+}
+
+IPAddress PortalServer::remoteIP() {
+  return _request->client()->remoteIP();
+}
+
+bool PortalServer::hasArg(const char* name) {
+  return _request->hasArg(name);
+}
+
+bool PortalServer::copyArg(const char* name, char* out, size_t size) {
+  if (!_request->hasArg(name)) {
+    return false;
+  }
+  const String& value = _request->arg(name);
+  if (value.length() >= size) {
+    return false;
+  }
+  memcpy(out, value.c_str(), value.length() + 1);
+  return true;
+}
+
+size_t PortalServer::takeBody(char* out, size_t size) {
+  char* buffer = static_cast<char*>(_request->_tempObject);
+  if (!buffer) {
+    return 0;
+  }
+  size_t length = strlen(buffer);
+  bool fits = length > 0 && length < size;
+  if (fits) {
+    memcpy(out, buffer, length + 1);
+  }
+  secureWipe(buffer, length);
+  return fits ? length : 0;
+}
+
+String PortalServer::header(const char* name) {
+  const AsyncWebHeader* value = _request->getHeader(name);
+  return value ? value->value() : String();
+}
+
+void PortalServer::sendHeader(const char* name, const char* value) {
+  if (_pendingHeaderCount < MAX_PENDING_HEADERS) {
+    _pendingHeaders[_pendingHeaderCount][0] = name;
+    _pendingHeaders[_pendingHeaderCount][1] = value;
+    _pendingHeaderCount++;
+  }
+}
+
+void PortalServer::send_P(int code, const char* contentType, PGM_P content, size_t length) {
+  sendResponse(_request->beginResponse_P(code, contentType,
+                                         reinterpret_cast<const uint8_t*>(content), length));
+}
+
+void PortalServer::stream(int code, const char* contentType, Renderer renderer) {
+  std::shared_ptr<StreamGuard> guard = std::make_shared<StreamGuard>(_streams, true);
+
+  AsyncWebServerResponse* response = _request->beginChunkedResponse(contentType,
+    [renderer, guard](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      // Ends the response early once the portal is being torn down
+      StreamLock lock(guard->_state->lock);
+      if (guard->_state->cancelled) return 0;
+      WindowResponseWriter out(reinterpret_cast<char*>(buffer), maxLen, index);
+      renderer(out);
+      return out.captured();
+    });
+  response->setCode(code);
+  sendResponse(response);
+}
+
+void PortalServer::streamWhenReady(int code, const char* contentType, Ready ready, Renderer renderer,
+                                   Renderer progress) {
+  std::shared_ptr<StreamGuard> guard = std::make_shared<StreamGuard>(_streams, false);
+
+  AsyncWebServerResponse* response = _request->beginChunkedResponse(contentType,
+    [ready, renderer, progress, guard](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      StreamLock lock(guard->_state->lock);
+      if (guard->_state->cancelled) return 0;
+      WindowResponseWriter out(reinterpret_cast<char*>(buffer), maxLen, index);
+      // Sends progress made since the last call, or asks the server to call
+      // back later instead of ending the response. Once rendering starts the
+      // data stays put, so ready() isn't asked again.
+      if (!guard->_armed) {
+        if (!ready()) {
+          if (progress) progress(out);
+          return out.captured() > 0 ? out.captured() : RESPONSE_TRY_AGAIN;
+        }
+        guard->arm();
+      }
+      if (progress) progress(out);
+      renderer(out);
+      return out.captured();
+    });
+  response->setCode(code);
+  sendResponse(response);
+}
+
+void PortalServer::sendResponse(AsyncWebServerResponse* response) {
+  for (size_t i = 0; i < _pendingHeaderCount; i++) {
+    response->addHeader(_pendingHeaders[i][0], _pendingHeaders[i][1]);
+  }
+  _pendingHeaderCount = 0;
+  _request->send(response);
+}
+
+#else // Synchronous WebServer
+
+namespace {
+
+HTTPMethod toHTTPMethod(PortalServer::Method method) {
+  switch (method) {
+    case PortalServer::GET: return HTTP_GET;
+    case PortalServer::POST: return HTTP_POST;
+    default: return HTTP_ANY;
+  }
+}
+
+} // namespace
+
+PortalServer::PortalServer(uint16_t port)
+  : _server(port), _requestCount(0), _handlerMicros(0), _maxHandlerMicros(0) {}
+
+void PortalServer::on(const char* uri, Method method, Handler handler, size_t maxBody) {
+  (void)maxBody;
+  _server.on(uri, toHTTPMethod(method), [this, handler]() { runHandler(handler); });
+}
+
+void PortalServer::onNotFound(Handler handler) {
+  _server.onNotFound([this, handler]() { runHandler(handler); });
+}
+
+void PortalServer::collectHeaders(const char* headers[], size_t count) {
+  _server.collectHeaders(headers, count);
+}
+
+// Handlers and their responses all run inside handleClient(), on the pump's
+// own task, so nothing is ever open or running concurrently
+bool PortalServer::isStreaming() const {
+  return false;
+}
+
+bool PortalServer::runExclusive(const std::function<void()>& change) {
+  change();
+  return true;
+}
+
+void PortalServer::cancelStreams() {}
+
+void PortalServer::begin() {
+  _server.begin();
+}
+
+void PortalServer::stop() {
+  _server.stop();
+}
+
+void PortalServer::handleClient() {
+  _server.handleClient();
+}
+
+String PortalServer::uri() {
+  return _server.uri();
+}
+
+bool PortalServer::isPost() {
+  return _server.method() == HTTP_POST;
+}
+
+IPAddress PortalServer::remoteIP() {
+  return _server.client().remoteIP();
+}
+
+bool PortalServer::hasArg(const char* name) {
+  return _server.hasArg(name);
+}
+
+// WebServer only hands out copies, so these wipe the copy before it is
+// freed. Its own parsed arguments are out of reach until the next request.
+bool PortalServer::copyArg(const char* name, char* out, size_t size) {
+  if (!_server.hasArg(name)) {
+    return false;
+  }
+  String value = _server.arg(name);
+  bool fits = value.length() < size;
+  if (fits) {
+    memcpy(out, value.c_str(), value.length() + 1);
+  }
+  secureWipe(value.begin(), value.length());
+  return fits;
+}
+
+size_t PortalServer::takeBody(char* out, size_t size) {
+  String body = _server.arg("plain");
+  size_t length = body.length();
+  bool fits = length > 0 && length < size;
+  if (fits) {
+    memcpy(out, body.c_str(), length + 1);
+  }
+  secureWipe(body.begin(), length);
+  return fits ? length : 0;
+}
+
+String PortalServer::header(const char* name) {
+  return _server.header(name);
+}
+
+void PortalServer::sendHeader(const char* name, const char* value) {
+  _server.sendHeader(name, value);
+}
+
+void PortalServer::send_P(int code, const char* contentType, PGM_P content, size_t length) {
+  _server.send_P(code, contentType, content, length);
+}
+
+void PortalServer::stream(int code, const char* contentType, Renderer renderer) {
+  // The response is complete before this returns, so nothing stays pending
+  ChunkedResponseWriter out(_server);
+  out.begin(code, contentType);
+  renderer(out);
+  out.end();
+}
+
+void PortalServer::streamWhenReady(int code, const char* contentType, Ready ready, Renderer renderer,
+                                   Renderer progress) {
+  if (!progress) {
+    while (!ready()) {
+      delay(10);
+    }
+    stream(code, contentType, renderer);
+    return;
+  }
+
+  ChunkedResponseWriter out(_server);
+  out.begin(code, contentType);
+  // Each poll renders progress again and sends only what it added
+  char window[64];
+  size_t sent = 0;
+  bool finished;
+  do {
+    finished = ready();
+    size_t captured;
+    do {
+      WindowResponseWriter step(window, sizeof(window), sent);
+      progress(step);
+      captured = step.captured();
+      out.write(window, captured);
+      sent += captured;
+    } while (captured == sizeof(window));
+    out.flush();
+    if (!finished) {
+      delay(10);
+    }
+  } while (!finished);
+  renderer(out);
+  out.end();
+}
+
+#endif
+
+void PortalServer::send(const FixedResponse& response) {
+  if (response.cacheControl) {
+    sendHeader("Cache-Control", response.cacheControl);
+  }
+  send_P(response.code, response.contentType, response.body, response.length);
+}
+
+void PortalServer::runHandler(const Handler& handler) {
+  uint32_t start = micros();
+  handler();
+  uint32_t elapsed = micros() - start;
+
+  _requestCount++;
+  _handlerMicros += elapsed;
+  if (elapsed > _maxHandlerMicros) {
+    _maxHandlerMicros = elapsed;
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef PORTAL_SERVER_H
+#define PORTAL_SERVER_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "response_writer.h"
+
+// HTTP backend used by the portal, selected at compile time:
+//   0 - the core's synchronous WebServer, pumped from handleClient()
+//   1 - ESPAsyncWebServer (requires AsyncTCP), which serves several
+//       connections at once from the AsyncTCP task
+#ifndef WIFI_PROV_ASYNC_SERVER
+#define WIFI_PROV_ASYNC_SERVER 0
+#endif
+
+#if WIFI_PROV_ASYNC_SERVER
+#include <ESPAsyncWebServer.h>
+#else
+#include <WebServer.h>
+#endif
+
+// A reply whose status, headers and body never change, see
+// fixed_responses.h. The body is in flash and sent from there.
+struct FixedResponse {
+  int code;
+  const char* contentType;
+  const char* cacheControl;  // nullptr to leave the header out
+  PGM_P body;
+  size_t length;
+};
+
+#if WIFI_PROV_ASYNC_SERVER
+struct PortalStreamState;
+#endif
+
+// Thin wrapper giving both backends the same route, request and response
+// API, so WiFiProvisioner registers and handles every route the same way.
+// Request accessors are only valid inside a handler.
+class PortalServer {
+public:
+  enum Method { ANY, GET, POST };
+
+  typedef std::function<void()> Handler;
+  typedef std::function<void(ResponseWriter&)> Renderer;
+  typedef std::function<bool()> Ready;
+
+  explicit PortalServer(uint16_t port);
+
+  // maxBody > 0 collects a POST body of up to that many bytes for
+  // takeBody(); larger bodies are dropped. The synchronous server always
+  // reads the body itself.
+  void on(const char* uri, Method method, Handler handler, size_t maxBody = 0);
+  void onNotFound(Handler handler);
+  // Request headers the handlers read; the synchronous server drops others
+  void collectHeaders(const char* headers[], size_t count);
+
+  void begin();
+  void stop();
+  // Services pending connections; a no-op for the async backend
+  void handleClient();
+
+  // Current request
+  String uri();
+  bool isPost();
+  IPAddress remoteIP();
+  bool hasArg(const char* name);
+  // Copies an argument into out, NUL-terminated, without keeping a String
+  // of it. False if it is missing or needs more than size bytes.
+  bool copyArg(const char* name, char* out, size_t size);
+  // Copies the POST body as sent, e.g. JSON, into out and wipes the
+  // server's copy where it can reach it. Returns the length, or 0 if there
+  // is no body or it needs more than size bytes.
+  size_t takeBody(char* out, size_t size);
+  String header(const char* name);
+
+  // Response. sendHeader() adds a header to the next response sent.
+  void sendHeader(const char* name, const char* value);
+  // Fixed replies never touch the heap: the body is sent straight from flash
+  void send(const FixedResponse& response);
+  void send_P(int code, const char* contentType, PGM_P content, size_t length);
+  // Streams a rendered body without holding it in RAM. The async backend
+  // calls the renderer again for every chunk, so it must produce the same
+  // output each time and may run after the handler has returned.
+  void stream(int code, const char* contentType, Renderer renderer);
+  // Like stream(), but the body is rendered only once ready() returns true,
+  // for answers that depend on something still in progress. The synchronous
+  // backend polls ready() inside the handler, so it must do any pumping
+  // needed meanwhile; the async backend sends the headers right away and
+  // polls ready() from the AsyncTCP task without blocking it. Until ready()
+  // holds, the response doesn't count towards isStreaming(), so the data it
+  // waits for can still be updated through runExclusive().
+  // progress, if set, renders what can be said while waiting, e.g. the steps
+  // an attempt has got through; what it adds is sent as it appears. Its
+  // output may only grow, as sent bytes stay sent, and the body ends with
+  // renderer's output after progress's final one.
+  void streamWhenReady(int code, const char* contentType, Ready ready, Renderer renderer,
+                       Renderer progress = nullptr);
+
+  // True while a streamed response may still call its renderer, i.e. while
+  // the data it renders from must not change
+  bool isStreaming() const;
+  // Runs change() only while no handler runs and no streamed response is
+  // open, so renderers never see data half-updated; returns whether it ran.
+  // Renderers and handlers of the async backend all run on the AsyncTCP
+  // task, so this is what makes updates from another task safe.
+  bool runExclusive(const std::function<void()>& change);
+  // Stops every handler and renderer from running again, ending open
+  // streamed responses early. Call before freeing what they render from.
+  void cancelStreams();
+
+  // Requests handled and time spent in handlers. The synchronous backend
+  // sends the whole response inside the handler; async handlers only queue it.
+  uint32_t requestCount() const { return _requestCount; }
+  uint32_t handlerMicros() const { return _handlerMicros; }
+  uint32_t maxHandlerMicros() const { return _maxHandlerMicros; }
+
+private:
+  void runHandler(const Handler& handler);
+
+#if WIFI_PROV_ASYNC_SERVER
+  static const size_t MAX_PENDING_HEADERS = 6;
+
+  void dispatch(AsyncWebServerRequest* request, const Handler& handler);
+  void sendResponse(AsyncWebServerResponse* response);
+
+  AsyncWebServer _server;
+  AsyncWebServerRequest* _request;
+  const char* _pendingHeaders[MAX_PENDING_HEADERS][2];
+  size_t _pendingHeaderCount;
+  std::shared_ptr<PortalStreamState> _streams;  // Also held by open responses
+#else
+  WebServer _server;
+#endif
+  uint32_t _requestCount;
+  uint32_t _handlerMicros;
+  uint32_t _maxHandlerMicros;
+};
+
+#endif // PORTAL_SERVER_H
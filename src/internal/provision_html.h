@@ -638,7 +638,7 @@ static constexpr const char index_html13[] PROGMEM =
         });
       }
 
-      function connectingState(state) {
+      function connectingState(state, label) {
         const ring = document.getElementById("connecting-ring");
         const submitBtn = document.getElementById("submit-btn");
 
@@ -646,7 +646,7 @@ static constexpr const char index_html13[] PROGMEM =
           return;
         }
 
-        const buttonTxt = state ? "Connecting" : "Connect";
+        const buttonTxt = state ? label || "Connecting" : "Connect";
         const ringVisi = state ? "" : "none";
         submitBtn.innerHTML = `${buttonTxt}<span id="connecting-ring" style="display:${ringVisi};" ></span>`;
         submitBtn.disabled = state;
@@ -728,7 +728,7 @@ static constexpr const char index_html13[] PROGMEM =
         })
           .then((response) => {
             if (!response.ok) throw new Error("Failed to connect");
-            return response.json();
+            return readConfigureResponse(response);
           })
           .then((jsonResponse) => {
             if (jsonResponse.success) {
@@ -758,6 +758,33 @@ static constexpr const char index_html13[] PROGMEM =
           });
       }
 
+      // While the device joins the network, the answer's "steps" array
+      // grows as each step is reached; show the latest on the button
+      function readConfigureResponse(response) {
+        if (!response.body || !window.TextDecoder) return response.json();
+
+        const labels = {
+          connecting: "Connecting",
+          associated: "Getting IP",
+          got_ip: "Connected",
+        };
+        const reader = response.body.getReader();
+        const decoder = new TextDecoder();
+        let text = "";
+
+        const readChunk = () =>
+          reader.read().then(({ done, value }) => {
+            if (done) return JSON.parse(text);
+            text += decoder.decode(value, { stream: true });
+            const steps = text.match(/"(connecting|associated|got_ip)"/g);
+            if (steps) {
+              connectingState(true, labels[steps[steps.length - 1].slice(1, -1)]);
+            }
+            return readChunk();
+          });
+        return readChunk();
+      }
+
       function successPage(ssid_text) {
         const card = document.getElementById("main-card");
         card.innerHTML = "";
@@ -768,11 +795,12 @@ static constexpr const char index_html13[] PROGMEM =
        <div class="container" style="padding: 1rem;">
          <h2 style="color:#7ac142;word-break: break-word;">Success</h2>
          <p style="color:#7ac142;word-break: break-word;font-size:1.2rem;margin-bottom: 0.5rem;">Succesfully connected to</p>
-         <p style="color:#7ac142;word-break: break-word;margin-top: 0rem;">${ssid_text}</p>
+         <p id="success-ssid" style="color:#7ac142;word-break: break-word;margin-top: 0rem;"></p>
          <p style="opacity: 0.5;">${connection_successful_text}</p>
          <p style="opacity: 0.5;">You can close the window</p>
        </div>
        `;
+        document.getElementById("success-ssid").textContent = ssid_text;
       }
 
       function onRadio(element) {
@@ -834,17 +862,31 @@ static constexpr const char index_html13[] PROGMEM =
       function addTableRow(ssid, authmode, rssi) {
         const locked = authmode > 0 ? 1 : 0;
         const icon = svgs["" + rssi + locked];
-        table.innerHTML += `
-       <tr>
-           <td class="radiossid">
-             <input type="radio" name="ssid" value="${ssid}" data-auth="${authmode}" onclick="onRadio(this)">
-           </td>
-           <td>${ssid}</td>
-           <td class="signal">
-             <svg xmlns="http://www.w3.org/2000/svg" style="vertical-align: -0.125em;" width="1em" height="1em" preserveAspectRatio="xMidYMid meet" viewBox="0 0 24 24"><path fill="var(--font-color)" ${icon}
-           </td>
-       </tr>
-       `;
+
+        // SSIDs are whatever nearby access points broadcast, so they only
+        // ever go into value and textContent, never into markup
+        const row = document.createElement("tr");
+
+        const radioCell = document.createElement("td");
+        radioCell.className = "radiossid";
+        const radio = document.createElement("input");
+        radio.type = "radio";
+        radio.name = "ssid";
+        radio.value = ssid;
+        radio.dataset.auth = authmode;
+        radio.onclick = () => onRadio(radio);
+        radioCell.appendChild(radio);
+
+        const ssidCell = document.createElement("td");
+        ssidCell.textContent = ssid;
+
+        // The icon markup is the page's own
+        const signalCell = document.createElement("td");
+        signalCell.className = "signal";
+        signalCell.innerHTML = `<svg xmlns="http://www.w3.org/2000/svg" style="vertical-align: -0.125em;" width="1em" height="1em" preserveAspectRatio="xMidYMid meet" viewBox="0 0 24 24"><path fill="var(--font-color)" ${icon}`;
+
+        row.append(radioCell, ssidCell, signalCell);
+        table.appendChild(row);
       }
 
       function togglePassShow() {
@@ -907,7 +949,7 @@ static constexpr const char index_html13[] PROGMEM =
         document.getElementById("factorylink").style.pointerEvents = linkstate;
       }
 
-      function connectingState(state) {
+      function connectingState(state, label) {
         const ring = document.getElementById("connecting-ring");
         const submitBtn = document.getElementById("submit-btn");
 
@@ -915,7 +957,7 @@ static constexpr const char index_html13[] PROGMEM =
           return;
         }
 
-        const buttonTxt = state ? "Connecting" : "Connect";
+        const buttonTxt = state ? label || "Connecting" : "Connect";
         const ringVisi = state ? "" : "none";
         submitBtn.innerHTML = `${buttonTxt}<span id="connecting-ring" style="display:${ringVisi};" ></span>`;
         submitBtn.disabled = state;
@@ -0,0 +1,114 @@
+#include "response_writer.h"
+#include "portal_server.h"
+
+#if !WIFI_PROV_ASYNC_SERVER
+#include <WebServer.h>
+
+ChunkedResponseWriter::ChunkedResponseWriter(WebServer& server)
+  : _server(server), _used(0) {}
+
+void ChunkedResponseWriter::begin(int code, const char* contentType) {
+  _used = 0;
+  _bytesWritten = 0;
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(code, contentType, "");
+}
+
+void ChunkedResponseWriter::write(const char* data, size_t length) {
+  _bytesWritten += length;
+
+  if (_used + length <= sizeof(_buffer)) {
+    memcpy(_buffer + _used, data, length);
+    _used += length;
+    return;
+  }
+
+  flush();
+  if (length >= sizeof(_buffer)) {
+    _server.sendContent(data, length);
+    return;
+  }
+
+  memcpy(_buffer, data, length);
+  _used = length;
+}
+
+void ChunkedResponseWriter::write_P(PGM_P data, size_t length) {
+  _bytesWritten += length;
+
+  if (_used + length <= sizeof(_buffer)) {
+    memcpy_P(_buffer + _used, data, length);
+    _used += length;
+    return;
+  }
+
+  flush();
+  if (length >= sizeof(_buffer)) {
+    _server.sendContent_P(data, length);
+    return;
+  }
+
+  memcpy_P(_buffer, data, length);
+  _used = length;
+}
+
+void ChunkedResponseWriter::end() {
+  flush();
+  _server.sendContent("", 0);
+}
+
+void ChunkedResponseWriter::flush() {
+  if (_used == 0) return;
+  _server.sendContent(_buffer, _used);
+  _used = 0;
+}
+#endif
+
+WindowResponseWriter::WindowResponseWriter(char* buffer, size_t capacity, size_t offset)
+  : _buffer(buffer), _capacity(capacity), _offset(offset), _captured(0) {}
+
+void WindowResponseWriter::write(const char* data, size_t length) {
+  copy(data, length, false);
+}
+
+void WindowResponseWriter::write_P(PGM_P data, size_t length) {
+  copy(data, length, true);
+}
+
+void WindowResponseWriter::copy(const char* data, size_t length, bool progmem) {
+  size_t start = _bytesWritten;
+  _bytesWritten += length;
+
+  // Skip everything before the window and stop once it is full
+  size_t windowPos = _offset + _captured;
+  if (_captured == _capacity || _bytesWritten <= windowPos) {
+    return;
+  }
+
+  size_t skip = windowPos - start;
+  size_t count = length - skip;
+  if (count > _capacity - _captured) {
+    count = _capacity - _captured;
+  }
+
+  if (progmem) {
+    memcpy_P(_buffer + _captured, data + skip, count);
+  } else {
+    memcpy(_buffer + _captured, data + skip, count);
+  }
+  _captured += count;
+}
+
+void DigestResponseWriter::write(const char* data, size_t length) {
+  _bytesWritten += length;
+  for (size_t i = 0; i < length; i++) {
+    _digest = (_digest ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+}
+
+void DigestResponseWriter::write_P(PGM_P data, size_t length) {
+  _bytesWritten += length;
+  for (size_t i = 0; i < length; i++) {
+    _digest = (_digest ^ pgm_read_byte(data + i)) * 16777619u;
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <Arduino.h>
+
+#ifndef WIFI_PROV_CHUNK_SIZE
+#define WIFI_PROV_CHUNK_SIZE 1024
+#endif
+
+// Sink that page and list renderers write into. Each HTTP backend
+// provides an implementation, so renderers never build a body in RAM.
+class ResponseWriter {
+public:
+  virtual ~ResponseWriter() {}
+
+  virtual void write(const char* data, size_t length) = 0;
+  virtual void write_P(PGM_P data, size_t length) = 0;
+
+  void write(const char* text) { write(text, strlen(text)); }
+  void write(const String& text) { write(text.c_str(), text.length()); }
+  void write_P(PGM_P text) { write_P(text, strlen_P(text)); }
+
+  size_t bytesWritten() const { return _bytesWritten; }
+
+protected:
+  ResponseWriter() : _bytesWritten(0) {}
+
+  size_t _bytesWritten;
+};
+
+#if !WIFI_PROV_ASYNC_SERVER
+class WebServer;
+
+// Streams a response as HTTP chunks through a small fixed buffer, so the
+// full page never has to exist in RAM. Small writes are coalesced into one
+// chunk; writes larger than the buffer go straight to the socket.
+class ChunkedResponseWriter : public ResponseWriter {
+public:
+  explicit ChunkedResponseWriter(WebServer& server);
+
+  // Sends the status line and headers with an unknown content length
+  void begin(int code, const char* contentType);
+
+  using ResponseWriter::write;
+  using ResponseWriter::write_P;
+  void write(const char* data, size_t length) override;
+  void write_P(PGM_P data, size_t length) override;
+
+  // Sends what is buffered as a chunk now, e.g. to show progress
+  void flush();
+  // Flushes pending data and sends the terminating chunk
+  void end();
+
+private:
+
+  WebServer& _server;
+  char _buffer[WIFI_PROV_CHUNK_SIZE];
+  size_t _used;
+};
+#endif
+
+// Captures one window of a response that is rendered again from the start
+// for every chunk. This lets pull-based servers serve a rendered page with
+// no per-response buffer: bytes before the window are only counted, and
+// bytes after it are dropped. Renderers must produce identical output on
+// each pass.
+class WindowResponseWriter : public ResponseWriter {
+public:
+  WindowResponseWriter(char* buffer, size_t capacity, size_t offset);
+
+  using ResponseWriter::write;
+  using ResponseWriter::write_P;
+  void write(const char* data, size_t length) override;
+  void write_P(PGM_P data, size_t length) override;
+
+  // Bytes copied into the window; 0 once the offset is past the end
+  size_t captured() const { return _captured; }
+
+private:
+  void copy(const char* data, size_t length, bool progmem);
+
+  char* _buffer;
+  size_t _capacity;
+  size_t _offset;
+  size_t _captured;
+};
+
+// Discards the output and keeps a 32-bit FNV-1a digest of it, e.g. to
+// derive an ETag by rendering a page once
+class DigestResponseWriter : public ResponseWriter {
+public:
+  DigestResponseWriter() : _digest(2166136261u) {}
+
+  using ResponseWriter::write;
+  using ResponseWriter::write_P;
+  void write(const char* data, size_t length) override;
+  void write_P(PGM_P data, size_t length) override;
+
+  uint32_t digest() const { return _digest; }
+
+private:
+  uint32_t _digest;
+};
+
+#endif // RESPONSE_WRITER_H
@@ -0,0 +1,75 @@
+#include "scan_cache.h"
+#include <WiFi.h>
+
+ScanCache::ScanCache() : _counts(), _current(0), _limit(CAPACITY), _valid(false), _updatedAt(0) {}
+
+size_t ScanCache::stage(int networkCount, bool first) {
+  if (first) {
+    _counts[_current ^ 1] = 0;
+  }
+
+  for (int i = 0; i < networkCount; i++) {
+    // Read the driver record directly to avoid a String per SSID
+    const wifi_ap_record_t* info = static_cast<const wifi_ap_record_t*>(WiFi.getScanInfoByIndex(i));
+    if (!info || info->ssid[0] == '\0') continue;  // Skip hidden networks
+
+    ScanRecord candidate;
+    memcpy(candidate.ssid, info->ssid, sizeof(candidate.ssid) - 1);
+    candidate.ssid[sizeof(candidate.ssid) - 1] = '\0';
+    candidate.rssi = info->rssi;
+    candidate.authMode = static_cast<uint8_t>(info->authmode);
+    candidate.channel = info->primary;
+    memcpy(candidate.bssid, info->bssid, sizeof(candidate.bssid));
+    insert(candidate);
+  }
+
+  WiFi.scanDelete();
+  return _counts[_current ^ 1];
+}
+
+void ScanCache::publish() {
+  _current ^= 1;
+  _valid = true;
+  _updatedAt = millis();
+}
+
+void ScanCache::insert(const ScanRecord& candidate) {
+  ScanRecord* records = _sets[_current ^ 1];
+  size_t& count = _counts[_current ^ 1];
+
+  // Slot the new entry takes over: the same SSID seen on a weaker BSSID, a
+  // free slot at the end, or the weakest record once the limit is reached
+  size_t slot = count;
+  for (size_t i = 0; i < count; i++) {
+    if (strcmp(records[i].ssid, candidate.ssid) == 0) {
+      if (records[i].rssi >= candidate.rssi) return;
+      slot = i;
+      break;
+    }
+  }
+  if (slot == count) {
+    if (count < _limit) {
+      count++;
+    } else if (count > 0 && records[count - 1].rssi < candidate.rssi) {
+      slot = count - 1;
+    } else {
+      return;
+    }
+  }
+
+  // Records are sorted strongest first, so shift the weaker ones down
+  size_t position = 0;
+  while (position < slot && records[position].rssi >= candidate.rssi) {
+    position++;
+  }
+  memmove(&records[position + 1], &records[position], (slot - position) * sizeof(ScanRecord));
+
+  records[position] = candidate;
+}
+
+void ScanCache::clear() {
+  _counts[0] = 0;
+  _counts[1] = 0;
+  _valid = false;
+  _updatedAt = 0;
+}
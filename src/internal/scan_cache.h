@@ -0,0 +1,62 @@
+#ifndef SCAN_CACHE_H
+#define SCAN_CACHE_H
+
+#include <Arduino.h>
+
+#ifndef WIFI_PROV_MAX_NETWORKS
+#define WIFI_PROV_MAX_NETWORKS 32
+#endif
+
+// One scanned access point, copied out of the driver's result list
+struct ScanRecord {
+  char ssid[33];      // NUL-terminated, up to 32 bytes per 802.11
+  int8_t rssi;
+  uint8_t authMode;   // wifi_auth_mode_t
+  uint8_t channel;
+  uint8_t bssid[6];
+};
+
+// Fixed-capacity copy of the last completed scan. Every renderer formats
+// from here, so the driver's results can be freed right after a scan.
+// Records are kept one per SSID, strongest first, so renderers only have to
+// walk the array in order. A scan in progress is collected in a second,
+// staging set, so the current records stay whole until it is published.
+class ScanCache {
+public:
+  static const size_t CAPACITY = WIFI_PROV_MAX_NETWORKS;
+
+  ScanCache();
+
+  // Copies the results of a completed scan pass of networkCount entries
+  // into the staging set and releases them with WiFi.scanDelete(). Hidden
+  // networks are skipped, an SSID seen on several BSSIDs keeps only its
+  // strongest entry, and once the limit is reached the weakest networks are
+  // dropped. first starts a new set; later passes are merged into it, so a
+  // scan split over several passes ends up the same as a single one.
+  // Returns the number of records staged.
+  size_t stage(int networkCount, bool first);
+  // Makes the staged set current, all at once
+  void publish();
+  void clear();
+
+  // Caps the number of records kept, at most CAPACITY
+  void setLimit(size_t limit) { _limit = (limit && limit < CAPACITY) ? limit : CAPACITY; }
+
+  // True once a scan has been copied in, even if it found nothing
+  bool isValid() const { return _valid; }
+  size_t count() const { return _counts[_current]; }
+  const ScanRecord& operator[](size_t index) const { return _sets[_current][index]; }
+  unsigned long updatedAt() const { return _updatedAt; }
+
+private:
+  void insert(const ScanRecord& candidate);
+
+  ScanRecord _sets[2][CAPACITY];  // Current and staging
+  size_t _counts[2];
+  uint8_t _current;
+  size_t _limit;
+  bool _valid;
+  unsigned long _updatedAt;
+};
+
+#endif // SCAN_CACHE_H
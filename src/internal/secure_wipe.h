@@ -0,0 +1,15 @@
+#ifndef SECURE_WIPE_H
+#define SECURE_WIPE_H
+
+#include <stddef.h>
+
+// Zeroes memory that held a secret. Plain memset() right before a free is a
+// dead store the compiler may drop; stores through volatile are kept.
+inline void secureWipe(void* data, size_t length) {
+  volatile unsigned char* p = static_cast<volatile unsigned char*>(data);
+  while (length--) {
+    *p++ = 0;
+  }
+}
+
+#endif // SECURE_WIPE_H
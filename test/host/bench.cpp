@@ -0,0 +1,156 @@
+// Host timings, heap allocations and response sizes for what the portal
+// does per scan and per request. The handlers run unchanged against the
+// shims: requests go through the recording WebServer, pages come from the
+// real data/wifiportal_example.html (via SPIFFS) and provision_html.h.
+// Absolute times say little about an ESP32 and sizes of the String and
+// std::function internals differ; compare runs against each other to spot
+// regressions. Run from test/host, as make bench does.
+
+#include "WiFiProvisioner.h"
+#include "internal/scan_cache.h"
+#include <SPIFFS.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include "host_alloc.h"
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+void* operator new(size_t size) {
+  if (hostAllocations.counting) {
+    hostAllocations.count++;
+    hostAllocations.bytes += size;
+  }
+  void* pointer = malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+namespace {
+
+const int ITERATIONS = 2000;
+const int REQUESTS = 200;
+const char* const EXAMPLE_PAGE = "../../data/wifiportal_example.html";
+
+void fillScan(size_t networks) {
+  WiFi.scanResults.clear();
+  for (size_t i = 0; i < networks; i++) {
+    wifi_ap_record_t record = {};
+    snprintf(reinterpret_cast<char*>(record.ssid), sizeof(record.ssid), "network-%zu", i);
+    record.rssi = static_cast<int8_t>(-30 - static_cast<int>((i * 37) % 60));
+    record.primary = static_cast<uint8_t>(1 + i % 13);
+    record.authmode = i % 4 ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    WiFi.scanResults.push_back(record);
+  }
+}
+
+void benchScan(size_t networks) {
+  ScanCache cache;
+  unsigned long total = 0;
+  for (int i = 0; i < ITERATIONS; i++) {
+    fillScan(networks);
+    unsigned long start = micros();
+    cache.stage(static_cast<int>(networks), true);
+    cache.publish();
+    total += micros() - start;
+  }
+  printf("scan %3zu networks: %8.2f us per stage+publish, %zu kept\n",
+         networks, static_cast<double>(total) / ITERATIONS, cache.count());
+}
+
+std::string readFile(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// One request type, sent REQUESTS times once the first scan is in
+void benchRequest(WebServer& server, const char* uri) {
+  server.keepChunks = false;
+  server.request(HTTP_GET, uri);  // Warm-up
+
+  unsigned long total = 0;
+  hostAllocations = {0, 0, false};
+  for (int i = 0; i < REQUESTS; i++) {
+    hostAllocations.counting = true;
+    unsigned long start = micros();
+    server.request(HTTP_GET, uri);
+    total += micros() - start;
+    hostAllocations.counting = false;
+  }
+
+  printf("  %-14s %4d %12.2f %10zu %8.1f %10.1f\n",
+         uri, server.status, static_cast<double>(total) / REQUESTS, server.bytesSent,
+         static_cast<double>(hostAllocations.count) / REQUESTS,
+         static_cast<double>(hostAllocations.bytes) / REQUESTS);
+}
+
+void benchPortal(const char* page, size_t networks) {
+  WiFiProvisioner provisioner;
+  WiFiProvisioner::Config& config = provisioner.getConfig();
+  SPIFFS.clear();
+  if (page == EXAMPLE_PAGE) {
+    SPIFFS.put("/wifiportal.html", readFile(EXAMPLE_PAGE));
+  } else {
+    config.USE_BUILTIN_PORTAL = true;
+  }
+
+  fillScan(networks);
+  hostAllocations = {0, 0, true};
+  bool started = provisioner.begin();
+  provisioner.loop();  // Picks up the first scan
+  hostAllocations.counting = false;
+  if (!started || !WebServer::current) {
+    printf("%s, %zu networks: portal failed to start\n", page, networks);
+    return;
+  }
+
+  printf("%s, %zu networks: begin() %zu allocs, %zu bytes, template load %u us\n",
+         page, networks, hostAllocations.count, hostAllocations.bytes,
+         (unsigned)provisioner.getStats().templateLoadMicros);
+  printf("  %-14s %4s %12s %10s %8s %10s\n", "request", "code", "us/request", "bytes",
+         "allocs", "alloc'd B");
+  WebServer& server = *WebServer::current;
+  benchRequest(server, "/");
+  benchRequest(server, "/update");
+  benchRequest(server, "/networks");
+  benchRequest(server, "/networks.json");
+  benchRequest(server, "/generate_204");
+  provisioner.end();
+}
+
+} // namespace
+
+int main() {
+  benchScan(0);
+  benchScan(10);
+  benchScan(60);
+
+  const char* const pages[] = {EXAMPLE_PAGE, "provision_html.h"};
+  const size_t networks[] = {0, 10, 60};
+  for (const char* page : pages) {
+    for (size_t count : networks) {
+      benchPortal(page, count);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the Arduino core for the library to build and run on the
+// host. Flash and RAM are the same address space here.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+
+inline size_t strlen_P(PGM_P text) { return strlen(text); }
+inline void* memcpy_P(void* dest, PGM_P src, size_t length) { return memcpy(dest, src, length); }
+inline uint8_t pgm_read_byte(const void* address) { return *static_cast<const uint8_t*>(address); }
+
+inline unsigned long micros() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return static_cast<unsigned long>(duration_cast<microseconds>(steady_clock::now() - start).count());
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+// glibc only gained strlcpy() in 2.38
+inline size_t hostStrlcpy(char* dest, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t count = length < size - 1 ? length : size - 1;
+    memcpy(dest, src, count);
+    dest[count] = '\0';
+  }
+  return length;
+}
+#define strlcpy hostStrlcpy
+
+class String {
+public:
+  String() {}
+  String(const char* text) : _text(text ? text : "") {}
+
+  const char* c_str() const { return _text.c_str(); }
+  char* begin() { return &_text[0]; }
+  unsigned length() const { return static_cast<unsigned>(_text.size()); }
+  bool isEmpty() const { return _text.empty(); }
+  int indexOf(const char* text) const {
+    size_t found = _text.find(text);
+    return found == std::string::npos ? -1 : static_cast<int>(found);
+  }
+
+  bool operator==(const char* text) const { return _text == text; }
+  bool operator==(const String& other) const { return _text == other._text; }
+  bool operator!=(const char* text) const { return _text != text; }
+  bool operator!=(const String& other) const { return _text != other._text; }
+
+private:
+  std::string _text;
+};
+
+// Log output goes to stderr, out of the way of test and bench results
+class HardwareSerial {
+public:
+  int printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(stderr, format, args);
+    va_end(args);
+    return written;
+  }
+};
+
+inline HardwareSerial Serial;
+
+// A heap that never runs low, so budgets are the only limit
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 200000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+};
+
+inline EspClass ESP;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,51 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <map>
+
+// In-memory filesystem: tests add files with put() and the library reads
+// them back through the usual open()/read() calls
+namespace fs {
+
+class File {
+public:
+  File() : _data(nullptr), _position(0) {}
+  explicit File(const std::string* data) : _data(data), _position(0) {}
+
+  explicit operator bool() const { return _data != nullptr; }
+  size_t size() const { return _data ? _data->size() : 0; }
+  size_t read(uint8_t* buffer, size_t length) {
+    if (!_data) return 0;
+    size_t count = _data->size() - _position;
+    if (count > length) count = length;
+    memcpy(buffer, _data->data() + _position, count);
+    _position += count;
+    return count;
+  }
+  void close() { _data = nullptr; }
+
+private:
+  const std::string* _data;
+  size_t _position;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* = "r") {
+    auto found = _files.find(path);
+    return found == _files.end() ? File() : File(&found->second);
+  }
+
+  void put(const char* path, const std::string& contents) { _files[path] = contents; }
+  void clear() { _files.clear(); }
+
+private:
+  std::map<std::string, std::string> _files;
+};
+
+} // namespace fs
+
+using fs::File;
+
+#endif // HOST_FS_H
@@ -0,0 +1,21 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+// NVS that never holds anything: every namespace fails to open
+class Preferences {
+public:
+  bool begin(const char*, bool = false) { return false; }
+  void end() {}
+  bool clear() { return false; }
+  bool remove(const char*) { return false; }
+  size_t putString(const char*, const char*) { return 0; }
+  size_t getString(const char*, char*, size_t) { return 0; }
+  size_t putBytes(const char*, const void*, size_t) { return 0; }
+  size_t getBytes(const char*, void*, size_t) { return 0; }
+  size_t putUChar(const char*, uint8_t) { return 0; }
+  uint8_t getUChar(const char*, uint8_t fallback = 0) { return fallback; }
+};
+
+#endif // HOST_PREFERENCES_H
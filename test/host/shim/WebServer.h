@@ -0,0 +1,128 @@
+#ifndef HOST_WEBSERVER_H
+#define HOST_WEBSERVER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <functional>
+#include <map>
+#include <vector>
+#include "host_alloc.h"
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+
+// Serves requests that tests hand to request() instead of reading them
+// from a socket, and records what the response sends. The last server
+// begun is in current, for code that only sees the library's public API.
+class WebServer {
+public:
+  typedef std::function<void()> THandlerFunction;
+  typedef std::map<std::string, std::string> Fields;
+
+  explicit WebServer(uint16_t = 80) {}
+  ~WebServer() { stop(); }
+
+  void on(const String& uri, HTTPMethod method, THandlerFunction handler) {
+    UncountedScope uncounted;
+    _routes.push_back({uri.c_str(), method, handler});
+  }
+  void onNotFound(THandlerFunction handler) { _notFound = handler; }
+  void collectHeaders(const char*[], size_t) {}
+  void begin() { current = this; }
+  void stop() {
+    if (current == this) current = nullptr;
+  }
+  void handleClient() {}
+
+  // Runs the handler for uri as if a client had sent the request; the
+  // response fields below then describe what it sent
+  void request(HTTPMethod method, const char* uri, const Fields& headers = Fields(),
+               const Fields& args = Fields()) {
+    {
+      UncountedScope uncounted;
+      _method = method;
+      _uri = uri;
+      _headers = headers;
+      _args = args;
+      status = 0;
+      contentType.clear();
+      contentLength = 0;
+      responseHeaders.clear();
+      chunks.clear();
+      bytesSent = 0;
+    }
+    for (const Route& route : _routes) {
+      if (route.uri == uri && (route.method == HTTP_ANY || route.method == method)) {
+        route.handler();
+        return;
+      }
+    }
+    if (_notFound) _notFound();
+  }
+
+  // Current request
+  String uri() { return String(_uri.c_str()); }
+  HTTPMethod method() { return _method; }
+  bool hasArg(const char* name) { return _args.count(name) > 0; }
+  String arg(const char* name) {
+    auto found = _args.find(name);
+    return found == _args.end() ? String() : String(found->second.c_str());
+  }
+  String header(const char* name) {
+    auto found = _headers.find(name);
+    return found == _headers.end() ? String() : String(found->second.c_str());
+  }
+  WiFiClient& client() { return _client; }
+
+  // Response
+  void sendHeader(const char* name, const char* value) {
+    UncountedScope uncounted;
+    responseHeaders[name] = value;
+  }
+  void setContentLength(size_t length) { contentLength = length; }
+  void send(int code, const char* type, const String& content) {
+    status = code;
+    contentType = type;
+    if (content.length() > 0) sendContent(content.c_str(), content.length());
+  }
+  void send_P(int code, const char* type, PGM_P content, size_t length) {
+    status = code;
+    contentType = type;
+    contentLength = length;
+    sendContent_P(content, length);
+  }
+  void sendContent(const char* data, size_t length) {
+    UncountedScope uncounted;
+    bytesSent += length;
+    if (keepChunks) chunks.emplace_back(data, length);
+  }
+  void sendContent_P(PGM_P data, size_t length) { sendContent(data, length); }
+
+  int status = 0;
+  std::string contentType;
+  size_t contentLength = 0;
+  std::map<std::string, std::string> responseHeaders;
+  std::vector<std::string> chunks;
+  size_t bytesSent = 0;
+  bool keepChunks = true;  // Off to only count bytes, e.g. when timing
+
+  static inline WebServer* current = nullptr;
+
+private:
+  struct Route {
+    std::string uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  std::vector<Route> _routes;
+  THandlerFunction _notFound;
+  HTTPMethod _method = HTTP_GET;
+  std::string _uri;
+  Fields _headers;
+  Fields _args;
+  WiFiClient _client;
+};
+
+#endif // HOST_WEBSERVER_H
@@ -0,0 +1,102 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <functional>
+#include <vector>
+
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_WPA2_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK
+} wifi_auth_mode_t;
+
+typedef struct wifi_ap_record_t {
+  uint8_t bssid[6];
+  uint8_t ssid[33];
+  uint8_t primary;
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+#define AP_STARTED_BIT (1 << 0)
+
+typedef enum { ARDUINO_EVENT_WIFI_AP_STACONNECTED } arduino_event_id_t;
+typedef int arduino_event_info_t;
+typedef size_t wifi_event_id_t;
+typedef std::function<void(arduino_event_id_t, arduino_event_info_t)> WiFiEventFuncCb;
+
+// The radio never leaves the host: the AP always starts, the station never
+// connects, and every scan completes at once with scanResults, which tests
+// fill in directly
+class WiFiClass {
+public:
+  int16_t scanNetworks(bool async = false, bool = false, bool = false, uint32_t = 300,
+                       uint8_t = 0, const char* = nullptr) {
+    scanned = true;
+    return async ? WIFI_SCAN_RUNNING : static_cast<int16_t>(scanResults.size());
+  }
+  int16_t scanComplete() { return scanned ? static_cast<int16_t>(scanResults.size()) : WIFI_SCAN_FAILED; }
+  void* getScanInfoByIndex(int index) {
+    if (index < 0 || static_cast<size_t>(index) >= scanResults.size()) return nullptr;
+    return &scanResults[index];
+  }
+  void scanDelete() {
+    scanResults.clear();
+    scanned = false;
+    scanDeletes++;
+  }
+
+  wifi_mode_t getMode() { return _mode; }
+  bool mode(wifi_mode_t mode) {
+    _mode = mode;
+    return true;
+  }
+  bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+  bool softAP(const char*, const char* = nullptr, int = 1) { return true; }
+  bool softAPdisconnect(bool = false) { return true; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  uint8_t softAPgetStationNum() { return 1; }
+  int waitStatusBits(int bits, uint32_t) { return bits & AP_STARTED_BIT; }
+
+  wl_status_t begin(const char*, const char* = nullptr, int32_t = 0, const uint8_t* = nullptr) {
+    return WL_DISCONNECTED;
+  }
+  bool disconnect(bool = false) { return true; }
+  wl_status_t status() { return WL_DISCONNECTED; }
+  String SSID() { return String(); }
+  int32_t channel() { return 0; }
+  uint8_t* BSSID() { return nullptr; }
+  IPAddress localIP() { return IPAddress(); }
+
+  wifi_event_id_t onEvent(WiFiEventFuncCb, arduino_event_id_t) { return 1; }
+  void removeEvent(wifi_event_id_t) {}
+
+  std::vector<wifi_ap_record_t> scanResults;
+  size_t scanDeletes = 0;
+  bool scanned = false;
+
+private:
+  wifi_mode_t _mode = WIFI_OFF;
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,12 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include <IPAddress.h>
+
+// The client of the request WebServer is currently handling
+class WiFiClient {
+public:
+  IPAddress remoteIP() const { return IPAddress(192, 168, 4, 2); }
+};
+
+#endif // HOST_WIFICLIENT_H
@@ -0,0 +1,40 @@
+#ifndef HOST_ESP_NOW_H
+#define HOST_ESP_NOW_H
+
+#include <esp_wifi.h>
+
+// ESP-NOW never initialises on the host, so fan-out stays off
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_KEY_LEN 16
+#define ESP_NOW_MAX_DATA_LEN 250
+
+typedef struct {
+  uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+  uint8_t lmk[ESP_NOW_KEY_LEN];
+  uint8_t channel;
+  wifi_interface_t ifidx;
+  bool encrypt;
+  void* priv;
+} esp_now_peer_info_t;
+
+typedef struct {
+  uint8_t* src_addr;
+  uint8_t* des_addr;
+  void* rx_ctrl;
+} esp_now_recv_info_t;
+
+typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t*, const uint8_t*, int);
+
+inline esp_err_t esp_now_init() { return ESP_FAIL; }
+inline esp_err_t esp_now_deinit() { return ESP_OK; }
+inline esp_err_t esp_now_set_pmk(const uint8_t*) { return ESP_OK; }
+inline esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t) { return ESP_OK; }
+inline esp_err_t esp_now_unregister_recv_cb() { return ESP_OK; }
+inline esp_err_t esp_now_add_peer(const esp_now_peer_info_t*) { return ESP_FAIL; }
+inline esp_err_t esp_now_mod_peer(const esp_now_peer_info_t*) { return ESP_FAIL; }
+inline esp_err_t esp_now_del_peer(const uint8_t*) { return ESP_OK; }
+inline bool esp_now_is_peer_exist(const uint8_t*) { return false; }
+inline esp_err_t esp_now_send(const uint8_t*, const uint8_t*, size_t) { return ESP_FAIL; }
+
+#endif // HOST_ESP_NOW_H
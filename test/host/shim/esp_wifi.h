@@ -0,0 +1,20 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include <WiFi.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum { WIFI_IF_STA = 0, WIFI_IF_AP } wifi_interface_t;
+
+inline esp_err_t esp_wifi_get_mac(wifi_interface_t, uint8_t* mac) {
+  static const uint8_t HOST_MAC[6] = {0x02, 0, 0, 0, 0, 1};
+  memcpy(mac, HOST_MAC, sizeof(HOST_MAC));
+  return ESP_OK;
+}
+// The station is never associated
+inline esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t*) { return ESP_FAIL; }
+
+#endif // HOST_ESP_WIFI_H
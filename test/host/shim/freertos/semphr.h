@@ -0,0 +1,14 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  static int mutex;
+  return &mutex;
+}
+inline void vSemaphoreDelete(SemaphoreHandle_t) {}
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t) { return pdTRUE; }
+
+#endif // HOST_FREERTOS_SEMPHR_H
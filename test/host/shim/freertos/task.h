@@ -0,0 +1,24 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+#include <Arduino.h>
+
+typedef void (*TaskFunction_t)(void*);
+enum eNotifyAction { eNoAction, eSetBits, eIncrement };
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t,
+                                          TaskHandle_t*, BaseType_t) {
+  return pdFAIL;
+}
+inline void vTaskDelete(TaskHandle_t) {}
+inline void vTaskSuspend(TaskHandle_t) {}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static int self;
+  return &self;
+}
+inline BaseType_t xTaskNotify(TaskHandle_t, uint32_t, eNotifyAction) { return pdPASS; }
+inline BaseType_t xTaskNotifyWait(uint32_t, uint32_t, uint32_t*, TickType_t) { return pdFALSE; }
+
+#endif // HOST_FREERTOS_TASK_H
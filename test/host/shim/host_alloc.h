@@ -0,0 +1,26 @@
+#ifndef HOST_ALLOC_H
+#define HOST_ALLOC_H
+
+#include <cstddef>
+
+// Heap allocations made while counting is on. bench.cpp replaces the global
+// operator new to fill this in; the shims pause it around their own
+// bookkeeping, so only what the library allocates is counted.
+struct HostAllocations {
+  size_t count;
+  size_t bytes;
+  bool counting;
+};
+
+inline HostAllocations hostAllocations = {0, 0, false};
+
+class UncountedScope {
+public:
+  UncountedScope() : _counting(hostAllocations.counting) { hostAllocations.counting = false; }
+  ~UncountedScope() { hostAllocations.counting = _counting; }
+
+private:
+  bool _counting;
+};
+
+#endif // HOST_ALLOC_H
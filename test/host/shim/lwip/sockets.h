@@ -0,0 +1,12 @@
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+// lwIP mirrors the BSD socket API, so the host's own sockets stand in
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif // HOST_LWIP_SOCKETS_H
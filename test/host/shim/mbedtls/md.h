@@ -0,0 +1,24 @@
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <cstddef>
+#include <cstring>
+
+// Digests fail and come out as zeros, which only matters to fan-out,
+// itself off on the host
+
+typedef enum { MBEDTLS_MD_SHA256 = 6 } mbedtls_md_type_t;
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+inline const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t) { return nullptr; }
+inline int mbedtls_md(const mbedtls_md_info_t*, const unsigned char*, size_t, unsigned char* output) {
+  memset(output, 0, 32);
+  return -1;
+}
+inline int mbedtls_md_hmac(const mbedtls_md_info_t*, const unsigned char*, size_t, const unsigned char*,
+                           size_t, unsigned char* output) {
+  memset(output, 0, 32);
+  return -1;
+}
+
+#endif // HOST_MBEDTLS_MD_H
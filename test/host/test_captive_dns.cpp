@@ -0,0 +1,106 @@
+#include "test_support.h"
+#include "internal/captive_dns.h"
+#include <lwip/sockets.h>
+#include <string>
+
+// Queries go over loopback to a CaptiveDns on an ephemeral port, so the
+// whole receive, parse and answer path runs as it does on the device
+
+namespace {
+
+const uint16_t TYPE_A = 1;
+const uint16_t TYPE_AAAA = 28;
+
+std::string query(uint16_t type, uint8_t flags = 0x01, const char* name = "\x0f" "msftconnecttest" "\x03" "com") {
+  std::string packet("\x12\x34", 2);
+  packet += static_cast<char>(flags);
+  packet += std::string("\x00\x00\x01\x00\x00\x00\x00\x00\x00", 9);
+  packet += name;
+  packet += '\0';
+  packet += static_cast<char>(type >> 8);
+  packet += static_cast<char>(type);
+  packet += std::string("\x00\x01", 2);  // Class IN
+  return packet;
+}
+
+uint16_t readU16(const std::string& packet, size_t pos) {
+  return static_cast<uint16_t>((static_cast<uint8_t>(packet[pos]) << 8) | static_cast<uint8_t>(packet[pos + 1]));
+}
+
+class Exchange {
+public:
+  Exchange() : _client(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) {
+    _started = _dns.start(0, IPAddress(192, 168, 4, 1));
+    socklen_t length = sizeof(_server);
+    getsockname(_dns.socket(), reinterpret_cast<sockaddr*>(&_server), &length);
+    _server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+  ~Exchange() { ::close(_client); }
+
+  bool started() const { return _started && _client >= 0; }
+
+  // Sends the packet, lets the responder poll, and returns its reply, or
+  // an empty string if it dropped the packet
+  std::string ask(const std::string& packet) {
+    ::sendto(_client, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&_server), sizeof(_server));
+    for (int attempt = 0; attempt < 100 && _dns.processPending() == 0; attempt++) {
+      usleep(1000);
+    }
+    char reply[512];
+    ssize_t length = ::recv(_client, reply, sizeof(reply), MSG_DONTWAIT);
+    return length > 0 ? std::string(reply, length) : std::string();
+  }
+
+private:
+  CaptiveDns _dns;
+  int _client;
+  bool _started;
+  sockaddr_in _server;
+};
+
+} // namespace
+
+TEST(answersAQueriesWithThePortalAddress) {
+  Exchange exchange;
+  CHECK(exchange.started());
+  std::string request = query(TYPE_A);
+  std::string reply = exchange.ask(request);
+  CHECK_EQ(reply.size(), request.size() + 16);
+  if (reply.size() != request.size() + 16) return;  // The reads below need a full answer
+  CHECK_EQ(readU16(reply, 0), 0x1234);
+  CHECK_EQ(static_cast<uint8_t>(reply[2]), 0x85);  // QR, AA, RD echoed
+  CHECK_EQ(readU16(reply, 6), 1);                  // One answer
+  CHECK_EQ(reply.compare(12, request.size() - 12, request, 12, request.size() - 12), 0);
+  CHECK_EQ(readU16(reply, request.size()), 0xC00C);
+  CHECK_EQ(readU16(reply, request.size() + 10), 4);
+  CHECK_EQ(reply.substr(reply.size() - 4), std::string("\xC0\xA8\x04\x01", 4));
+}
+
+TEST(answersOtherTypesWithNoRecords) {
+  Exchange exchange;
+  std::string request = query(TYPE_AAAA);
+  std::string reply = exchange.ask(request);
+  CHECK_EQ(reply.size(), request.size());
+  CHECK_EQ(readU16(reply, 6), 0);
+  CHECK_EQ(reply[3] & 0x0F, 0);  // NOERROR
+}
+
+TEST(dropsTrailingRecords) {
+  Exchange exchange;
+  std::string request = query(TYPE_A);
+  request[11] = 1;  // ARCOUNT, e.g. EDNS
+  request += std::string("\x00\x00\x29\x10\x00\x00\x00\x00\x00\x00\x00", 11);
+  std::string reply = exchange.ask(request);
+  CHECK_EQ(reply.size(), request.size() - 11 + 16);
+  CHECK_EQ(readU16(reply, 10), 0);
+}
+
+TEST(ignoresResponsesAndMalformedQueries) {
+  Exchange exchange;
+  CHECK(exchange.ask(query(TYPE_A, 0x81)).empty());                        // QR set
+  CHECK(exchange.ask(query(TYPE_A, 0x29)).empty());                        // Opcode 5
+  CHECK(exchange.ask(query(TYPE_A, 0x01, "\x03" "abc\xC0\x0C")).empty());  // Pointer in the name
+  CHECK(exchange.ask(query(TYPE_A).substr(0, 20)).empty());                // Truncated
+  CHECK(exchange.ask(std::string("\x12\x34\x01", 3)).empty());             // Shorter than a header
+  CHECK(!exchange.ask(query(TYPE_A)).empty());
+}
@@ -0,0 +1,105 @@
+#include "test_support.h"
+#include "internal/html_template.h"
+#include <string>
+
+namespace {
+
+fs::FS files;
+
+std::string literal(const HtmlTemplate& page, size_t index) {
+  const HtmlTemplate::Segment& segment = page.segment(index);
+  return std::string(page.data() + segment.offset, segment.length);
+}
+
+} // namespace
+
+TEST(splitsAtKnownPlaceholders) {
+  files.put("/page.html", "<title>{{HTML_TITLE}}</title><ul>{{NETWORKS_LIST}}</ul>");
+  HtmlTemplate page;
+  CHECK(page.load(files, "/page.html"));
+  CHECK_EQ(page.segmentCount(), 3u);
+  CHECK_EQ(literal(page, 0), "<title>");
+  CHECK_EQ(page.segment(0).slot, HtmlTemplate::SLOT_HTML_TITLE);
+  CHECK_EQ(literal(page, 1), "</title><ul>");
+  CHECK_EQ(page.segment(1).slot, HtmlTemplate::SLOT_NETWORKS_LIST);
+  CHECK_EQ(literal(page, 2), "</ul>");
+  CHECK_EQ(page.segment(2).slot, HtmlTemplate::SLOT_NONE);
+  CHECK_EQ(page.literalLength(), strlen("<title></title><ul></ul>"));
+  CHECK(page.hasSlot(HtmlTemplate::SLOT_NETWORKS_LIST));
+  CHECK(!page.hasSlot(HtmlTemplate::SLOT_FOOTER_TEXT));
+}
+
+TEST(keepsUnknownPlaceholdersAsText) {
+  files.put("/page.html", "{{ {{UNKNOWN}} {{FOOTER_TEXT");
+  HtmlTemplate page;
+  CHECK(page.load(files, "/page.html"));
+  CHECK_EQ(page.segmentCount(), 1u);
+  CHECK_EQ(literal(page, 0), "{{ {{UNKNOWN}} {{FOOTER_TEXT");
+}
+
+TEST(leavesPlaceholdersBeyondTheSegmentTableAsText) {
+  std::string text;
+  for (size_t i = 0; i < HtmlTemplate::MAX_SEGMENTS + 2; i++) {
+    text += "x{{THEME_COLOR}}";
+  }
+  files.put("/page.html", text);
+  HtmlTemplate page;
+  CHECK(page.load(files, "/page.html"));
+  CHECK_EQ(page.segmentCount(), HtmlTemplate::MAX_SEGMENTS);
+  CHECK_EQ(page.segment(HtmlTemplate::MAX_SEGMENTS - 1).slot, HtmlTemplate::SLOT_NONE);
+  CHECK_EQ(literal(page, HtmlTemplate::MAX_SEGMENTS - 1), "x{{THEME_COLOR}}x{{THEME_COLOR}}x{{THEME_COLOR}}");
+}
+
+TEST(keepsBinaryAssetsWhole) {
+  files.put("/page.html.gz", std::string("\x1f\x8b{{HTML_TITLE}}\0z", 18));
+  HtmlTemplate page;
+  CHECK(page.load(files, "/page.html.gz", false));
+  CHECK_EQ(page.segmentCount(), 1u);
+  CHECK_EQ(page.length(), 18u);
+  CHECK_EQ(page.literalLength(), 18u);
+}
+
+TEST(rejectsMissingEmptyAndOversizedFiles) {
+  HtmlTemplate page;
+  CHECK(!page.load(files, "/missing.html"));
+  files.put("/empty.html", "");
+  CHECK(!page.load(files, "/empty.html"));
+  files.put("/page.html", "0123456789");
+  CHECK(!page.load(files, "/page.html", true, 10));  // Needs room for the NUL
+  CHECK(!page.isLoaded());
+  CHECK(page.load(files, "/page.html", true, 11));
+}
+
+TEST(attachesPrecomputedSegments) {
+  static const char DATA[] = "<p>{{FOOTER_TEXT}}</p>";
+  const HtmlTemplate::Segment segments[] = {
+    {0, 3, HtmlTemplate::SLOT_FOOTER_TEXT},
+    {18, 4, HtmlTemplate::SLOT_NONE},
+  };
+  HtmlTemplate page;
+  CHECK(page.attach(DATA, sizeof(DATA) - 1, segments, 2));
+  CHECK_EQ(page.data(), DATA);
+  CHECK_EQ(page.segmentCount(), 2u);
+  CHECK_EQ(page.literalLength(), 7u);
+
+  CHECK(!page.attach(nullptr, 10, segments, 2));
+  CHECK(!page.attach(DATA, sizeof(DATA) - 1, segments, 0));
+  CHECK(!page.attach(DATA, sizeof(DATA) - 1, segments, HtmlTemplate::MAX_SEGMENTS + 1));
+}
+
+TEST(rejectsSegmentsOutsideTheData) {
+  static const char DATA[] = "<p></p>";
+  const size_t length = sizeof(DATA) - 1;
+  HtmlTemplate page;
+
+  const HtmlTemplate::Segment pastTheEnd[] = {{3, 5, HtmlTemplate::SLOT_NONE}};
+  CHECK(!page.attach(DATA, length, pastTheEnd, 1));
+  const HtmlTemplate::Segment wrapsAround[] = {{4, 0xFFFFFFFFu, HtmlTemplate::SLOT_NONE}};
+  CHECK(!page.attach(DATA, length, wrapsAround, 1));
+  const HtmlTemplate::Segment badSlot[] = {{0, 3, static_cast<HtmlTemplate::Slot>(200)}};
+  CHECK(!page.attach(DATA, length, badSlot, 1));
+  CHECK(!page.isLoaded());
+
+  const HtmlTemplate::Segment exact[] = {{0, 3, HtmlTemplate::SLOT_FOOTER_TEXT}, {3, 4, HtmlTemplate::SLOT_NONE}};
+  CHECK(page.attach(DATA, length, exact, 2));
+}
@@ -0,0 +1,27 @@
+#include "test_support.h"
+
+namespace {
+
+int failures = 0;
+const char* currentTest = nullptr;
+
+} // namespace
+
+std::vector<TestCase>& testRegistry() {
+  static std::vector<TestCase> registry;
+  return registry;
+}
+
+void recordFailure(const char* file, int line, const char* expression) {
+  failures++;
+  printf("FAIL %s (%s:%d): %s\n", currentTest, file, line, expression);
+}
+
+int main() {
+  for (const TestCase& test : testRegistry()) {
+    currentTest = test.name;
+    test.run();
+  }
+  printf("%zu tests, %d failed checks\n", testRegistry().size(), failures);
+  return failures == 0 ? 0 : 1;
+}
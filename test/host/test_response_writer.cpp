@@ -0,0 +1,104 @@
+#include "test_support.h"
+#include "internal/response_writer.h"
+#include <WebServer.h>
+#include <string>
+
+namespace {
+
+// Writes the same output in pieces of varying sizes and kinds
+void render(ResponseWriter& out) {
+  out.write("<html>");
+  out.write_P(PSTR("0123456789abcdef"), 16);
+  out.write(String("<body>"));
+  for (int i = 0; i < 20; i++) {
+    out.write("row", 3);
+  }
+  out.write_P(PSTR("</body></html>"));
+}
+
+std::string renderAll() {
+  struct Capture : ResponseWriter {
+    void write(const char* data, size_t length) override { text.append(data, length); }
+    void write_P(PGM_P data, size_t length) override { text.append(data, length); }
+    std::string text;
+  } capture;
+  render(capture);
+  return capture.text;
+}
+
+} // namespace
+
+TEST(windowsReassembleTheWholeResponse) {
+  const std::string expected = renderAll();
+  for (size_t capacity : {1u, 5u, 7u, 64u, 1024u}) {
+    std::string assembled;
+    char buffer[1024];
+    for (;;) {
+      WindowResponseWriter window(buffer, capacity, assembled.size());
+      render(window);
+      CHECK_EQ(window.bytesWritten(), expected.size());
+      if (window.captured() == 0) break;
+      CHECK(window.captured() <= capacity);
+      assembled.append(buffer, window.captured());
+    }
+    CHECK_EQ(assembled, expected);
+  }
+}
+
+TEST(windowPastTheEndCapturesNothing) {
+  char buffer[16];
+  WindowResponseWriter window(buffer, sizeof(buffer), renderAll().size() + 5);
+  render(window);
+  CHECK_EQ(window.captured(), 0u);
+}
+
+TEST(digestIsFnv1a) {
+  DigestResponseWriter empty;
+  CHECK_EQ(empty.digest(), 2166136261u);
+
+  DigestResponseWriter digest;
+  digest.write("a");
+  CHECK_EQ(digest.digest(), 0xe40c292cu);
+
+  // Same bytes, same digest, however they are split
+  DigestResponseWriter whole;
+  whole.write("foobar");
+  DigestResponseWriter pieces;
+  pieces.write("foo");
+  pieces.write_P(PSTR("bar"));
+  CHECK_EQ(whole.digest(), 0xbf9cf968u);
+  CHECK_EQ(pieces.digest(), whole.digest());
+  CHECK_EQ(pieces.bytesWritten(), 6u);
+}
+
+TEST(chunkedWriterCoalescesSmallWrites) {
+  WebServer server;
+  ChunkedResponseWriter out(server);
+  out.begin(200, "text/html");
+  CHECK_EQ(server.status, 200);
+  CHECK_EQ(server.contentLength, CONTENT_LENGTH_UNKNOWN);
+
+  render(out);
+  out.end();
+  // Everything fits the buffer: one data chunk and the terminator
+  CHECK_EQ(server.chunks.size(), 2u);
+  CHECK_EQ(server.chunks[0], renderAll());
+  CHECK(server.chunks[1].empty());
+}
+
+TEST(chunkedWriterSendsLargeWritesDirectly) {
+  WebServer server;
+  ChunkedResponseWriter out(server);
+  out.begin(200, "text/html");
+
+  const std::string large(WIFI_PROV_CHUNK_SIZE + 100, 'x');
+  out.write("head");
+  out.write(large.data(), large.size());
+  out.write("tail");
+  out.end();
+  CHECK_EQ(server.chunks.size(), 4u);
+  CHECK_EQ(server.chunks[0], "head");
+  CHECK_EQ(server.chunks[1], large);
+  CHECK_EQ(server.chunks[2], "tail");
+  CHECK_EQ(out.bytesWritten(), large.size() + 8);
+}
@@ -0,0 +1,109 @@
+#include "test_support.h"
+#include "internal/scan_cache.h"
+#include <WiFi.h>
+
+namespace {
+
+void addNetwork(const char* ssid, int8_t rssi, uint8_t channel = 1) {
+  wifi_ap_record_t record = {};
+  strncpy(reinterpret_cast<char*>(record.ssid), ssid, sizeof(record.ssid) - 1);
+  record.rssi = rssi;
+  record.primary = channel;
+  record.authmode = WIFI_AUTH_WPA2_PSK;
+  WiFi.scanResults.push_back(record);
+}
+
+size_t stageResults(ScanCache& cache, bool first = true) {
+  return cache.stage(static_cast<int>(WiFi.scanResults.size()), first);
+}
+
+} // namespace
+
+TEST(keepsStrongestEntryPerSsidInOrder) {
+  ScanCache cache;
+  addNetwork("office", -70, 1);
+  addNetwork("", -30);  // Hidden
+  addNetwork("home", -50, 6);
+  addNetwork("office", -40, 11);
+  addNetwork("cafe", -80);
+  size_t deletes = WiFi.scanDeletes;
+  CHECK_EQ(stageResults(cache), 3u);
+  CHECK_EQ(WiFi.scanDeletes, deletes + 1);
+  CHECK(WiFi.scanResults.empty());
+
+  cache.publish();
+  CHECK(cache.isValid());
+  CHECK_EQ(cache.count(), 3u);
+  CHECK_EQ(strcmp(cache[0].ssid, "office"), 0);
+  CHECK_EQ(cache[0].rssi, -40);
+  CHECK_EQ(cache[0].channel, 11);
+  CHECK_EQ(strcmp(cache[1].ssid, "home"), 0);
+  CHECK_EQ(strcmp(cache[2].ssid, "cafe"), 0);
+}
+
+TEST(dropsWeakestNetworksAtTheLimit) {
+  ScanCache cache;
+  cache.setLimit(2);
+  addNetwork("a", -60);
+  addNetwork("b", -70);
+  addNetwork("c", -50);
+  addNetwork("d", -90);
+  CHECK_EQ(stageResults(cache), 2u);
+  cache.publish();
+  CHECK_EQ(strcmp(cache[0].ssid, "c"), 0);
+  CHECK_EQ(strcmp(cache[1].ssid, "a"), 0);
+}
+
+TEST(holdsAtMostCapacityRecords) {
+  ScanCache cache;
+  char ssid[8];
+  for (size_t i = 0; i < ScanCache::CAPACITY + 10; i++) {
+    snprintf(ssid, sizeof(ssid), "n%zu", i);
+    addNetwork(ssid, static_cast<int8_t>(-100 + static_cast<int>(i)));
+  }
+  CHECK_EQ(stageResults(cache), ScanCache::CAPACITY);
+  cache.publish();
+  CHECK_EQ(cache[0].rssi, -100 + static_cast<int>(ScanCache::CAPACITY + 9));
+  CHECK_EQ(cache[ScanCache::CAPACITY - 1].rssi, -100 + 10);
+}
+
+TEST(keepsCurrentRecordsUntilPublished) {
+  ScanCache cache;
+  addNetwork("old", -50);
+  stageResults(cache);
+  cache.publish();
+
+  addNetwork("new", -40);
+  stageResults(cache);
+  CHECK_EQ(cache.count(), 1u);
+  CHECK_EQ(strcmp(cache[0].ssid, "old"), 0);
+
+  cache.publish();
+  CHECK_EQ(strcmp(cache[0].ssid, "new"), 0);
+}
+
+TEST(mergesLaterPassesIntoTheStagedSet) {
+  ScanCache cache;
+  addNetwork("a", -60);
+  addNetwork("b", -70);
+  stageResults(cache, true);
+  addNetwork("b", -45);
+  addNetwork("c", -80);
+  CHECK_EQ(stageResults(cache, false), 3u);
+  cache.publish();
+  CHECK_EQ(strcmp(cache[0].ssid, "b"), 0);
+  CHECK_EQ(cache[0].rssi, -45);
+  CHECK_EQ(strcmp(cache[1].ssid, "a"), 0);
+  CHECK_EQ(strcmp(cache[2].ssid, "c"), 0);
+}
+
+TEST(publishesAnEmptyScan) {
+  ScanCache cache;
+  CHECK(!cache.isValid());
+  CHECK_EQ(stageResults(cache), 0u);
+  cache.publish();
+  CHECK(cache.isValid());
+  CHECK_EQ(cache.count(), 0u);
+  cache.clear();
+  CHECK(!cache.isValid());
+}
@@ -0,0 +1,34 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdio>
+#include <vector>
+
+// Minimal self-registering test cases, so the host tests need nothing
+// beyond a C++17 compiler
+
+struct TestCase {
+  const char* name;
+  void (*run)();
+};
+
+std::vector<TestCase>& testRegistry();
+void recordFailure(const char* file, int line, const char* expression);
+
+struct TestRegistrar {
+  TestRegistrar(const char* name, void (*run)()) { testRegistry().push_back({name, run}); }
+};
+
+#define TEST(name)                                              \
+  static void name();                                           \
+  static TestRegistrar name##_registrar(#name, name);           \
+  static void name()
+
+#define CHECK(condition)                                        \
+  do {                                                          \
+    if (!(condition)) recordFailure(__FILE__, __LINE__, #condition); \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) CHECK((actual) == (expected))
+
+#endif // TEST_SUPPORT_H